@@ -14,6 +14,7 @@ static void freeundo(BUFFER buffer);
 static struct undo_s *allocundo(BUFFER buf);
 static void bufdo(BUFFER buf, ELVBOOL wipe);
 static void didmodify(BUFFER buf);
+static int bulkread(CHAR *iobuf, int len);
 # ifdef FEATURE_MISC
   static void proc(_BLKNO_ bufinfo, long nchars, long nlines, long changes,
   			long prevloc, CHAR *name);
@@ -65,6 +66,12 @@ BUFFER bufdefopts;
 static ELVBOOL bufnoedit;
 #endif
 
+/* These are used by bulkread() to read large chunks of a file */
+static CHAR	bulkbuf[32768];	/* text read from the file but not used yet */
+static int	bulkused;	/* number of CHARs used from bulkbuf[] */
+static int	bulkqty;	/* number of CHARs in bulkbuf[] */
+static ELVBOOL	bulkcancel;	/* did the user cancel the bulk load? */
+
 /* This array describes buffer options */
 static OPTDESC bdesc[] =
 {
@@ -1724,6 +1731,7 @@ ELVBOOL bufread(mark, rfile)
 	long	origlines;	/* original number of lines in file */
 	CHAR	chunk[4096];	/* I/O buffer */
 	int	nread;		/* number of bytes in chunk[] */
+	long	nchars, nlines;	/* totals from a bulk load */
 	ELVBOOL	newbuf;		/* is this a new buffer? */
 #ifdef FEATURE_AUTOCMD
 	ELVBOOL	filter;
@@ -1770,7 +1778,53 @@ ELVBOOL bufread(mark, rfile)
 	/* read the text */
 	if (newbuf)
 		msg(MSG_STATUS, "[s]reading $1", rfile);
-	while ((nread = ioread(chunk, QTY(chunk))) > 0)
+	if (o_bufchars(buf) == 0
+#ifdef FEATURE_AUTOCMD
+	 && (o_internal(buf) || bufnoedit || !(buf->willdo || buf->eachedit))
+#endif
+	   )
+	{
+		/* The buffer is empty, and no Edit event is needed, so we can
+		 * load the whole file directly into CHARS blocks and then
+		 * adjust the buffer's totals and marks just once.
+		 */
+		if (buf->willdo)
+		{
+			bufdo(buf, ElvTrue);
+			buf->willdo = ElvFalse;
+		}
+		bulkcancel = ElvFalse;
+		bulkused = bulkqty = 0;
+#ifdef FEATURE_LAZYLOAD
+		/* If the file is huge, and its text needs no conversion,
+		 * then maybe leave its text in the file until it's needed.
+		 */
+		nlines = -1L;
+		if (o_lazyload > 0 && ioraw() && urllocal(rfile))
+			nlines = lowlazy(buf->bufinfo, urllocal(rfile),
+					o_lazyload * 1048576L, &nchars);
+		if (nlines < 0L)
+#endif
+			nlines = lowload(buf->bufinfo, bulkread, &nchars);
+		if (nchars > 0)
+		{
+			o_buflines(buf) += nlines;
+			o_bufchars(buf) += nchars;
+			buf->changes++;
+#ifdef DISPLAY_ANYMARKUP
+			dmmuadjust(mark, mark, nchars);
+#endif
+			markadjust(mark, mark, nchars);
+			marksetoffset(mark, nchars);
+			didmodify(buf);
+		}
+		if (bulkcancel)
+		{
+			ioclose();
+			return ElvFalse;
+		}
+	}
+	else while ((nread = ioread(chunk, QTY(chunk))) > 0)
 	{
 		if (guipoll(ElvFalse))
 		{
@@ -1813,6 +1867,34 @@ ELVBOOL bufread(mark, rfile)
 	return ElvTrue;
 }
 
+/* Read text for lowload(), via ioread().  The text is read in large chunks,
+ * since lowload() asks for one block's worth at a time.  Before each chunk,
+ * this checks whether the user wants to cancel, in which case it sets
+ * bulkcancel and returns 0.
+ */
+static int bulkread(iobuf, len)
+	CHAR	*iobuf;	/* where to store the text */
+	int	len;	/* maximum number of characters to read */
+{
+	if (bulkused >= bulkqty)
+	{
+		if (guipoll(ElvFalse))
+		{
+			bulkcancel = ElvTrue;
+			return 0;
+		}
+		bulkqty = ioread(bulkbuf, QTY(bulkbuf));
+		bulkused = 0;
+		if (bulkqty <= 0)
+			return bulkqty;
+	}
+	if (len > bulkqty - bulkused)
+		len = bulkqty - bulkused;
+	memcpy(iobuf, &bulkbuf[bulkused], len * sizeof(CHAR));
+	bulkused += len;
+	return len;
+}
+
 /* Create a buffer for a given file, and then load the file.  Return a pointer
  * to the buffer.  If the file can't be read for some reason, then complain and
  * leave the buffer empty, but still return the empty buffer.
@@ -2606,6 +2688,14 @@ ELVBOOL bufwrite(from, to, wfile, force)
 			marksetoffset(to, markoffset(&next));
 	}
 
+#ifdef FEATURE_LAZYLOAD
+	/* If any text is still being read from the file lazily, then copy
+	 * it into the session file before the file is clobbered.
+	 */
+	if (!filter && !append && urllocal(wfile))
+		sesunlazy(urllocal(wfile));
+#endif
+
 	/* Try to write the file */
 	if (ioopen(wfile, append ? 'a' : 'w', ElvFalse, ElvTrue,
 		o_writeenc == 's'
@@ -136,6 +136,9 @@ static CHAR *feature[] =
 # ifdef FEATURE_MKEXRC
 	toLCHAR("mkexrc"),
 # endif
+# ifdef FEATURE_MMAP
+	toLCHAR("mmap"),
+# endif
 # ifdef FEATURE_NORMAL
 	toLCHAR("normal"),
 # endif
@@ -151,6 +154,9 @@ static CHAR *feature[] =
 # ifdef FEATURE_RCSID
 	toLCHAR("rcsid"),
 # endif
+# ifdef FEATURE_REGDFA
+	toLCHAR("regdfa"),
+# endif
 # ifdef FEATURE_REGION
 	toLCHAR("region"),
 # endif
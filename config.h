@@ -46,6 +46,7 @@
 #define	FEATURE_HLSEARCH  /* the hlsearch option */
 #define	FEATURE_IMAGE	/* background images in x11 */
 #define	FEATURE_INCSEARCH /* the incsearch option */
+#define	FEATURE_LAZYLOAD /* read huge files on demand; see "lazyload" */
 #define	FEATURE_LISTCHARS /* the "listchars" option */
 #define	FEATURE_LITRE	/* accelerate searches for literal strings */
 #define	FEATURE_LPR	/* the :lpr command */
@@ -53,10 +54,12 @@
 #define	FEATURE_MAPDB	/* the map debugger */
 #define	FEATURE_MISC	/* lots of little things -- see comment below */
 #define	FEATURE_MKEXRC	/* the :mkexrc command */
+#define	FEATURE_MMAP	/* map the session file into memory if "-f mmap" */
 #define	FEATURE_NORMAL	/* vim-style :normal command */
 #define	FEATURE_PROTO	/* using aliases to add new protocols */
 #undef	FEATURE_RAM	/* store edit buffer in RAM if "-f ram" */
 #define	FEATURE_RCSID	/* include RCS Id strings for all source files */
+#define	FEATURE_REGDFA	/* run regexps as automata instead of backtracking */
 #define FEATURE_REGION	/* the :region and :unregion commands */
 #define	FEATURE_SHOWTAG	/* the showtag option */
 #define	FEATURE_SMARTARGS /* the smartargs option */
@@ -80,14 +80,61 @@ void bufreplace(MARK from, MARK to, CHAR *newp, long newlen)
 {
 }
 
+/* dump a subtree of a buffer's blklist tree */
+static void dumptree(BLKNO node, long height, BLKNO parent, char *bufname, BLK *bufinfo)
+{
+	BLK	*blk;
+	BLK	*chars;
+	int	j;
+
+	/* read the blklist or blktree block */
+	if (!bufname) printf("%6ld      %s for #%ld\n", (long)node, height > 0 ? "blktree" : "blklist", (long)parent);
+	sesalloc(node, height > 0 ? SES_BLKTREE : SES_BLKLIST);
+	seslock(node, ElvFalse, height > 0 ? SES_BLKTREE : SES_BLKLIST);
+	blk = sesblk(node);
+
+	/* for each subtree... */
+	for (j = 0; height > 0 && j < SES_MAXBLKTREE && blk->blktree.kid[j].child; j++)
+	{
+		if (!bufname) printf("%6ld          subtree #%ld[%d], blocks=%ld, chars=%ld, lines=%ld\n",
+			(long)blk->blktree.kid[j].child,
+			(long)node,
+			j,
+			(long)blk->blktree.kid[j].nblks,
+			blk->blktree.kid[j].nchars,
+			blk->blktree.kid[j].nlines);
+		dumptree(blk->blktree.kid[j].child, height - 1, node, bufname, bufinfo);
+	}
+
+	/* for each chars block... */
+	for (j = 0; height == 0 && j < SES_MAXBLKLIST && blk->blklist.blk[j].blkno; j++)
+	{
+		if (!bufname) printf("%6ld          chars #%ld[%d], chars=%ld, lines=%ld\n",
+			(long)blk->blklist.blk[j].blkno,
+			(long)node,
+			j,
+			(long)blk->blklist.blk[j].nchars,
+			(long)blk->blklist.blk[j].nlines);
+		if (bufname && !strcmp(bufname, bufinfo->bufinfo.name))
+		{
+			/* read the chars block & output its contents */
+			sesalloc(blk->blklist.blk[j].blkno, SES_CHARS);
+			seslock(blk->blklist.blk[j].blkno, ElvFalse, SES_CHARS);
+			chars = sesblk(blk->blklist.blk[j].blkno);
+			fwrite(chars->chars.chars, blk->blklist.blk[j].nchars, sizeof(CHAR), stdout);
+			sesunlock(blk->blklist.blk[j].blkno, ElvFalse);
+		}
+	}
+
+	/* release the block */
+	sesunlock(node, ElvFalse);
+}
+
 void dump(char *bufname, ELVBOOL useronly)
 {
 	BLK	*super;
 	BLK	*bufinfo;
-	BLK	*blklist;
-	BLK	*chars;
-	BLKNO	blkno, next;
-	int	i, j;
+	int	i;
 
 	sesopen(ElvTrue);
 	seslock(0, ElvFalse, SES_SUPER);
@@ -114,10 +161,11 @@ void dump(char *bufname, ELVBOOL useronly)
 
 		/* output buffer name, unless we're supposed to list contents */
 		if (!bufname)
-			printf("%6d  bufinfo, bufname=\"%s\", changes=%ld\n",
-				super->super.buf[i],
+			printf("%6ld  bufinfo, bufname=\"%s\", changes=%ld%s\n",
+				(long)super->super.buf[i],
 				bufinfo->bufinfo.name,
-				bufinfo->bufinfo.changes);
+				bufinfo->bufinfo.changes,
+				bufinfo->bufinfo.lazy ? ", lazy" : "");
 
 		/* if "-u" and we don't have a buffer name, then we're done */
 		if (useronly && !bufname)
@@ -126,40 +174,9 @@ void dump(char *bufname, ELVBOOL useronly)
 			continue;
 		}
 
-		/* for each blklist block... */
-		for (blkno = bufinfo->bufinfo.first; blkno; blkno = next)
-		{
-			if (!bufname) printf("%6d      blklist for #%d\n", blkno, super->super.buf[i]);
-
-			/* read the blklist block */
-			sesalloc(blkno, SES_BLKLIST);
-			seslock(blkno, ElvFalse, SES_BLKLIST);
-			blklist = sesblk(blkno);
-
-			/* for each chars block... */
-			for (j = 0; j < SES_MAXBLKLIST && blklist->blklist.blk[j].blkno; j++)
-			{
-				if (!bufname) printf("%6d          chars #%d[%d], chars=%d, lines=%d\n",
-					blklist->blklist.blk[j].blkno,
-					blkno,
-					j,
-					blklist->blklist.blk[j].nchars,
-					blklist->blklist.blk[j].nlines);
-				if (bufname && !strcmp(bufname, bufinfo->bufinfo.name))
-				{
-					/* read the chars block & output its contents */
-					sesalloc(blklist->blklist.blk[j].blkno, SES_CHARS);
-					seslock(blklist->blklist.blk[j].blkno, ElvFalse, SES_CHARS);
-					chars = sesblk(blklist->blklist.blk[j].blkno);
-					fwrite(chars->chars.chars, blklist->blklist.blk[j].nchars, sizeof(CHAR), stdout);
-					sesunlock(blklist->blklist.blk[j].blkno, ElvFalse);
-				}
-			}
-
-			/* release the blklist block */
-			next = blklist->blklist.next;
-			sesunlock(blkno, ElvFalse);
-		}
+		/* dump the tree of blklist blocks */
+		if (bufinfo->bufinfo.first)
+			dumptree(bufinfo->bufinfo.first, bufinfo->bufinfo.height, super->super.buf[i], bufname, bufinfo);
 
 		/* release the bufinfo block */
 		sesunlock(super->super.buf[i], ElvFalse);
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 
 #include "config.h"
 #include "version.h"
@@ -131,6 +132,7 @@ extern char *tochar8 P_((CHAR *s));	/* function in char.c */
 # define CHARcmp(s,t)	wcscmp((s), (t))
 # define CHARncmp(s,t,n) wcsncmp((s), (t), (n))
 # define CHARset(s,c,n)	wmemset((s), (c), (n))
+# define CHARmemchr(s,c,n) wmemchr((s), (c), (n))
 # define CHARdup(s)	safeCHARdup(s)
 # define CHARkdup(s)	safekCHARdup(s)
 # define long2CHAR(s,l)	((void)swprintf((s), "%ld", (l)))
@@ -149,6 +151,7 @@ extern char *tochar8 P_((CHAR *s));	/* function in char.c */
 # define CHARcmp(s,t)	(strcmp((char *)(s), (char *)(t)))
 # define CHARncmp(s,t,n) (strncmp((char *)(s), (char *)(t), (n)))
 # define CHARset(s,c,n)	memset((s), (c), (n))
+# define CHARmemchr(s,c,n) ((CHAR *)memchr((s), (c), (n)))
 # define CHARdup(s)	((CHAR *)safedup(tochar8(s)))
 # define CHARkdup(s)	((CHAR *)safekdup(tochar8(s)))
 # define long2CHAR(s,l)	((void)sprintf((char *)(s), "%ld", (l)))
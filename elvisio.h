@@ -12,6 +12,9 @@ extern ELVBOOL	ioopen P_((char *name, _char_ rwa, ELVBOOL prgsafe, ELVBOOL force
 extern int	iowrite P_((CHAR *iobuf, int len));
 extern int	ioread P_((CHAR *iobuf, int len));
 extern ELVBOOL	ioclose P_((void));
+#ifdef FEATURE_LAZYLOAD
+extern ELVBOOL	ioraw P_((void));
+#endif
 extern char	*iopath P_((char *path, char *filename, ELVBOOL usefile));
 extern char	*iofilename P_((char *partial, _char_ endchar));
 extern char	*ioenc P_((char *filename));
@@ -157,6 +157,7 @@ static struct
 /*ca  */{"calculate",	EX_CALC,	ex_comment,	a_Cmds,					q_Exrc				},
 /*cas */{"case",	EX_CASE,	ex_case,	a_Lhs | a_Cmds,				q_Exrc				},
 #endif
+/*cac */{"cachestat",	EX_CACHESTAT,	ex_cachestat,	a_Bang,					q_None				},
 #ifdef FEATURE_MAKE
 /*cc  */{"cc",		EX_CC,		ex_make,	a_Bang | a_Rhs,				q_Unsafe | q_Restricted | q_SwitchB},
 #endif
@@ -650,8 +651,10 @@ ELVBOOL exparseaddress(refp, xinf)
 	long	lnum;	/* line number */
 	long	delta;	/* movement amount */
 	CHAR	sign;	/* '+' or '-' for delta */
-	long	start;	/* where search stared, so we can detect wrap */
-	long	buflines;/* number of lines in buffer */
+	long	start;	/* start of the default line */
+	long	end;	/* end of the default line */
+	long	found;	/* start of the line containing a match */
+	BUFFER	buf;	/* the buffer being searched */
 	MARKBUF	m;	/* start of a line */
 	MARK	mark;
 	CHAR	ch;
@@ -706,53 +709,41 @@ ELVBOOL exparseaddress(refp, xinf)
 			xinf->re = NULL;
 		}
 
-		/* search for the regular expression */
-		start = lnum;
-		buflines = o_buflines(markbuffer(&xinf->defaddr));
-		do
+		/* search for the regular expression, in the lines after (or
+		 * before) the default line.  Maybe wrap around to search the
+		 * rest of the buffer, except for the default line itself.
+		 */
+		buf = markbuffer(&xinf->defaddr);
+		start = lowline(bi, lnum);
+		end = (lnum >= o_buflines(buf) ? o_bufchars(buf) : lowline(bi, lnum + 1));
+		if (delta > 0)
+			found = regsearch(re, marktmp(m, buf, end), o_bufchars(buf), ElvTrue);
+		else
+			found = regsearch(re, marktmp(m, buf, start), 0L, ElvFalse);
+		if (found == -1 && !o_wrapscan)
 		{
-			/* find next line */
-			lnum += delta;
-			if (o_wrapscan)
-			{
-				if (lnum == 0)
-					lnum = buflines;
-				else if (lnum > buflines)
-					lnum = 1;
-			}
-			else if (lnum == 0)
-			{
-				msg(MSG_ERROR, "no match above");
-				return ElvFalse;
-			}
-			else if (lnum > buflines)
-			{
-				msg(MSG_ERROR, "no match below");
-				return ElvFalse;
-			}
-
-			/* see if this line contains the regexp */
-			if (regexec(re, marktmp(m, markbuffer(&xinf->defaddr), lowline(bi, lnum)), ElvTrue))
-			{
-				delta = 0;
-			}
-
-			/* if we've wrapped back to our starting point,
-			 * then we've failed.
-			 */
-			if (lnum == start)
+			msg(MSG_ERROR, delta > 0 ? "no match below" : "no match above");
+			return ElvFalse;
+		}
+		else if (found == -1)
+		{
+			if (delta > 0)
+				found = regsearch(re, marktmp(m, buf, 0L), start, ElvTrue);
+			else
+				found = regsearch(re, marktmp(m, buf, o_bufchars(buf)), end, ElvFalse);
+			if (found == -1)
 			{
 				msg(MSG_ERROR, "no match");
 				return ElvFalse;
 			}
+		}
 
-			/* did the user cancel the search? */
-			if (guipoll(ElvFalse))
-			{
-				return ElvFalse;
-			}
-
-		} while (delta != 0);
+		/* did the user cancel the search? */
+		if (found < 0)
+		{
+			return ElvFalse;
+		}
+		lnum = markline(marktmp(m, buf, found));
 
 		/* If we get here, then we've found a match, and lnum is set
 		 * to its line number.  Good!
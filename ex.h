@@ -26,8 +26,8 @@ typedef enum
 	EX_ABBR, EX_ALIAS, EX_ALL, EX_APPEND, EX_ARGS, EX_AT, EX_AUTOCMD,
 		EX_AUEVENT, EX_AUGROUP,
 	EX_BANG, EX_BBROWSE, EX_BREAK, EX_BROWSE, EX_BUFFER,
-	EX_CALC, EX_CASE, EX_CC, EX_CD, EX_CHANGE, EX_CHECK, EX_CHREGION,
-		EX_CLOSE, EX_COLOR, EX_COMMENT, EX_COPY,
+	EX_CACHESTAT, EX_CALC, EX_CASE, EX_CC, EX_CD, EX_CHANGE, EX_CHECK,
+		EX_CHREGION, EX_CLOSE, EX_COLOR, EX_COMMENT, EX_COPY,
 	EX_DEFAULT, EX_DELETE, EX_DIGRAPH, EX_DISPLAY, EX_DO,
 		EX_DOALIAS, EX_DOAUTOCMD, EX_DOPROTO,
 	EX_ECHO, EX_EDIT, EX_ELSE, EX_EQUAL, EX_ERRLIST, EX_ERROR, EX_EVAL,
@@ -148,6 +148,7 @@ extern RESULT	ex_at P_((EXINFO *xinf));
 extern RESULT	ex_bang P_((EXINFO *xinf));
 extern RESULT	ex_browse P_((EXINFO *xinf));
 extern RESULT	ex_buffer P_((EXINFO *xinf));
+extern RESULT	ex_cachestat P_((EXINFO *xinf));
 extern RESULT	ex_case P_((EXINFO *xinf));
 extern RESULT	ex_cd P_((EXINFO *xinf));
 extern RESULT	ex_check P_((EXINFO *xinf));
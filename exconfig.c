@@ -2342,6 +2342,14 @@ RESULT	ex_version(xinf)
 }
 
 
+RESULT	ex_cachestat(xinf)
+	EXINFO	*xinf;
+{
+	sesstats(xinf->bang);
+	return RESULT_COMPLETE;
+}
+
+
 RESULT	ex_qall(xinf)
 	EXINFO	*xinf;
 {
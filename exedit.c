@@ -71,6 +71,8 @@ RESULT	ex_global(xinf)
 	MARK	orig;
 	MARKBUF	thisln;
 	long	origlines;
+	long	found;
+	ELVBOOL	selected;
 
 	assert(xinf->command == EX_GLOBAL || xinf->command == EX_VGLOBAL);
 
@@ -116,23 +118,46 @@ RESULT	ex_global(xinf)
 	ret = RESULT_COMPLETE;
 	while (cp && markoffset(xinf->fromaddr) < markoffset(xinf->toaddr))
 	{
-		/* find the end of this line */
-		for (lenln = 0; cp && *cp != '\n'; lenln++)
-			(void)scannext(&cp);
-		if (cp)
+		/* For :g, skip to the next line which contains a match.  The
+		 * lines in between are never looked at individually.
+		 */
+		if (xinf->command == EX_GLOBAL)
 		{
-			(void)scannext(&cp);
-			lenln++;
+			found = regsearch(xinf->re, xinf->fromaddr,
+					markoffset(xinf->toaddr), ElvTrue);
+			if (found < 0)
+				break;
+			endln = xinf->re->nextlinep;
+			if (endln > markoffset(xinf->toaddr))
+				endln = markoffset(xinf->toaddr);
+			lenln = endln - found;
+			marksetoffset(xinf->fromaddr, endln);
+			scanseek(&cp, xinf->fromaddr);
+			selected = ElvTrue;
 		}
+		else
+		{
+			/* find the end of this line */
+			for (lenln = 0; cp && *cp != '\n'; lenln++)
+				(void)scannext(&cp);
+			if (cp)
+			{
+				(void)scannext(&cp);
+				lenln++;
+			}
+
+			/* move "fromaddr" to end of this line (start of next
+			 * line)
+			 */
+			thisln = *xinf->fromaddr;
+			endln = cp ? markoffset(scanmark(&cp)) : markoffset(xinf->toaddr);
+			marksetoffset(xinf->fromaddr, endln);
 
-		/* move "fromaddr" to end of this line (start of next line) */
-		thisln = *xinf->fromaddr;
-		endln = cp ? markoffset(scanmark(&cp)) : markoffset(xinf->toaddr);
-		marksetoffset(xinf->fromaddr, endln);
+			/* is this a selected line? */
+			selected = (ELVBOOL)!regexec(xinf->re, &thisln, ElvTrue);
+		}
 
-		/* is this a selected line? */
-		if ((regexec(xinf->re, &thisln, ElvTrue) ? EX_GLOBAL : EX_VGLOBAL)
-			== xinf->command)
+		if (selected)
 		{
 
 			/* move the cursor to the matching line */
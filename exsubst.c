@@ -110,6 +110,9 @@ static void print(subst)
 static ELVBOOL findnext(subst)
 	subst_t	*subst;	/* info about the substitution */
 {
+	long	found;	/* start of a line containing a match, or -1 */
+	ELVBOOL	ready;	/* has a match already been found at subst->from? */
+
 	/* if previous line was supposed to be printed but hasn't been,
 	 * then print it now.
 	 */
@@ -123,10 +126,32 @@ static ELVBOOL findnext(subst)
 		if (guipoll(ElvFalse))
 			return ElvFalse;
 
+		/* if at the start of a line, then skip to the next line which
+		 * contains a match.
+		 */
+		ready = ElvFalse;
+		if (subst->thisinst == 0)
+		{
+			found = regsearch(subst->re, subst->from,
+					markoffset(subst->to), ElvTrue);
+			if (found == -2)
+				return ElvFalse;
+			if (found < 0)
+			{
+				marksetoffset(subst->from, markoffset(subst->to));
+				break;
+			}
+			marksetoffset(subst->from, found);
+			ready = ElvTrue;
+		}
+
 		/* for each instance within the line... */
-		while (regexec(subst->re, subst->from, (ELVBOOL)(subst->thisinst == 0))
+		while ((ready
+			|| regexec(subst->re, subst->from, (ELVBOOL)(subst->thisinst == 0)))
 		    && (subst->global || subst->thisinst < subst->instance))
 		{
+			ready = ElvFalse;
+
 			/* increment the instance counter */
 			subst->thisinst++;
 
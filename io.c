@@ -461,6 +461,20 @@ int ioread(iobuf, len)
 	return nread;
 }
 
+#ifdef FEATURE_LAZYLOAD
+/* Return ElvTrue if the file being read is a local file, and its text will be
+ * read without any conversion.  Such a file's text could be read directly
+ * from the file instead of via ioread().  This assumes that text mode is the
+ * same as binary mode, which is true on all systems which support lazy
+ * loading.
+ */
+ELVBOOL ioraw()
+{
+	return (ELVBOOL)(reading && forfile && !beautify && sizeof(CHAR) == 1
+		&& (convert == 'b' || convert == 't'));
+}
+#endif
+
 /* Close a file that was opened via ioopen().  Return TRUE if successful, or
  * FALSE if something went wrong.  Generally, the only way something could go
  * wrong is if you're writing to a program, and the program's exit code != 0
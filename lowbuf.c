@@ -19,10 +19,22 @@ char id_lowbuf[] = "$Id: lowbuf.c,v 2.47 2006/12/01 23:09:36 steve Exp $";
 
 #if USE_PROTOTYPES
 static short checksum(BLK *blk);
-static BLKNO delblock(_BLKNO_ blklist, _LBLKNO_ lblkno, COUNT *ncharsptr, COUNT *nlinesptr);
-static BLKNO insblock(_BLKNO_ blklist, _LBLKNO_ before, _BLKNO_ chars, _COUNT_ nchars, _COUNT_ nlines);
+static int nentries(BLK *blk, long height);
+static void addrefs(BLK *blk, long height, int from, int to);
+static BLKNO locknode(_BLKNO_ node, long height);
+static void subtotal(BLK *blk, long height, int from, int to, struct blkt_s *tot);
+static void insentry(BLK *blk, long height, int pos, char *entry, struct blkt_s *split);
+static ELVBOOL mergekids(BLK *blk, long height, int i);
+static BLKNO descend(_BLKNO_ bufinfo, int key, long want, struct blkt_s *before);
+static BLKNO chgblock(_BLKNO_ node, long height, _LBLKNO_ lblkno, _BLKNO_ blkno, int chgchars, int chglines);
+static BLKNO delblock(_BLKNO_ node, long height, _LBLKNO_ lblkno, struct blki_s *deleted, int *nleft);
+static void delroot(BLK *binfo, _LBLKNO_ lblkno, struct blki_s *deleted);
+static BLKNO insblock(_BLKNO_ node, long height, _LBLKNO_ before, struct blki_s *blki, struct blkt_s *split);
+static void insroot(BLK *binfo, _LBLKNO_ before, _BLKNO_ chars, _COUNT_ nchars, _COUNT_ nlines);
+static void freetree(_BLKNO_ node, long height);
 static BLKNO lockchars(_BLKNO_ bufinfo, _LBLKNO_ lblkno, _BLKNO_ blkno);
 static void unlockchars(_BLKNO_ bufinfo, _LBLKNO_ lblkno, _BLKNO_ blkno, int chgchars, int chglines);
+static ELVBOOL inittree(_BLKNO_ node, long height, struct blkt_s *tot);
 static void helpinit(_BLKNO_ bufinfo, void (*bufproc)(_BLKNO_ bufinfo, long nchars, long nlines, long changes, long prevloc, CHAR *name));
 #endif
 
@@ -30,6 +42,30 @@ static void helpinit(_BLKNO_ bufinfo, void (*bufproc)(_BLKNO_ bufinfo, long ncha
 static void clobbercache P_((_BLKNO_ dst));
 #endif
 
+/* These are the things that descend() can search for */
+#define BY_LBLKNO	0	/* a logical block number */
+#define BY_OFFSET	1	/* a character offset */
+#define BY_LINE		2	/* a number of newlines to skip */
+
+/* These macros allow the entries of BLKLIST blocks (height 0) and BLKTREE
+ * blocks (height > 0) to be shifted around by the same code.
+ */
+#define NODETYPE(h)	((h) > 0 ? SES_BLKTREE : SES_BLKLIST)
+#define MAXENTRY(h)	((int)((h) > 0 ? SES_MAXBLKTREE : SES_MAXBLKLIST))
+#define ENTRYSIZE(h)	((h) > 0 ? sizeof(struct blkt_s) : sizeof(struct blki_s))
+#define ENTRY(b,h,i)	((h) > 0 ? (char *)&(b)->blktree.kid[i] : (char *)&(b)->blklist.blk[i])
+
+/* When a split or merge changes the shape of the tree, the changed nodes are
+ * flushed from the bottom up, so the session file never refers to a node
+ * which hasn't been written yet.  A block removed from the tree isn't reused
+ * until its parent has been flushed.  The bufinfo block can't be flushed
+ * while lowdelete() has it locked, so old roots are remembered here until
+ * then.
+ */
+#define MAXOLDROOT	32
+static BLKNO	oldroot[MAXOLDROOT];
+static int	noldroots;
+
 /******************************************************************************/
 /* Some internal functions...						      */
 
@@ -67,196 +103,617 @@ static short checksum(blk)
 }
 
 
-/* This function deletes one whole CHARS block from a BLKLIST block, and
- * returns the BLKNO of the altered version of the block which the "blklist"
- * argument referred to.  This function is recursive.
+/* Return the number of entries in use in a BLKLIST or BLKTREE block */
+static int nentries(blk, height)
+	BLK	*blk;	/* contents of a BLKLIST or BLKTREE block */
+	long	height;	/* height of the block; 0 for BLKLIST */
+{
+	int	i;
+
+	if (height > 0)
+		for (i = 0; i < MAXENTRY(height) && blk->blktree.kid[i].child; i++)
+		{
+		}
+	else
+		for (i = 0; i < MAXENTRY(height) && blk->blklist.blk[i].blkno; i++)
+		{
+		}
+	return i;
+}
+
+/* Add a reference to each subtree or CHARS block mentioned in a range of
+ * entries in a BLKLIST or BLKTREE block.
+ */
+static void addrefs(blk, height, from, to)
+	BLK	*blk;	/* contents of a BLKLIST or BLKTREE block */
+	long	height;	/* height of the block; 0 for BLKLIST */
+	int	from;	/* index of first entry */
+	int	to;	/* index of entry after the last one */
+{
+	for (; from < to; from++)
+	{
+		if (height > 0)
+			(void)sesalloc(blk->blktree.kid[from].child, NODETYPE(height - 1));
+		else
+			(void)sesalloc(blk->blklist.blk[from].blkno, SES_CHARS);
+	}
+}
+
+/* Lock a BLKLIST or BLKTREE block for writing.  Versions of a buffer share
+ * any part of the tree which they have in common, so if this block is shared
+ * then it is copied first, and the copy adds a reference to everything that
+ * it refers to.  The caller should flush a copy after unlocking it, before
+ * anything else refers to it.  Returns the BLKNO of the locked block.
  */
-static BLKNO delblock(blklist, lblkno, ncharsptr, nlinesptr)
-	_BLKNO_	blklist;	/* a BLKLIST block */
-	_LBLKNO_ lblkno;	/* index into blklist's array of blocks */
-	COUNT	*ncharsptr;	/* number of characters deleted */
-	COUNT	*nlinesptr;	/* number of lines deleted */
+static BLKNO locknode(node, height)
+	_BLKNO_	node;	/* a BLKLIST or BLKTREE block */
+	long	height;	/* height of the block; 0 for BLKLIST */
 {
-	BLKNO	next;
+	BLKNO	copy;
 	BLK	*blk;
 
-	assert(blklist != 0);
+	copy = seslock(node, ElvTrue, NODETYPE(height));
+	if (copy != node)
+	{
+		blk = sesblk(copy);
+		addrefs(blk, height, 0, nentries(blk, height));
+	}
+	return copy;
+}
 
-	/* if the lblkno is in a later block, then delete it recursively
-	 * and watch out for the next blklist being copied-on-write!
-	 */
-	if (lblkno >= SES_MAXBLKLIST)
+/* Compute the totals for a range of entries in a BLKLIST or BLKTREE block.
+ * The "child" field of the totals is set to 0.
+ */
+static void subtotal(blk, height, from, to, tot)
+	BLK	*blk;	/* contents of a BLKLIST or BLKTREE block */
+	long	height;	/* height of the block; 0 for BLKLIST */
+	int	from;	/* index of first entry to include */
+	int	to;	/* index of entry after the last one to include */
+	struct blkt_s *tot; /* output: totals of those entries */
+{
+	tot->child = 0;
+	tot->nblks = 0;
+	tot->nchars = tot->nlines = 0L;
+	for (; from < to; from++)
 	{
-		blklist = seslock(blklist, ElvTrue, SES_BLKLIST);
-		blk = sesblk(blklist);
-		next = delblock(blk->blklist.next, (LBLKNO)(lblkno - SES_MAXBLKLIST), ncharsptr, nlinesptr);
-		if (next == blk->blklist.next)
+		if (height > 0)
 		{
-			sesunlock(blklist, ElvFalse);
+			tot->nblks += blk->blktree.kid[from].nblks;
+			tot->nchars += blk->blktree.kid[from].nchars;
+			tot->nlines += blk->blktree.kid[from].nlines;
 		}
 		else
 		{
-			blk->blklist.next = next;
-			sesunlock(blklist, ElvTrue);
+			tot->nblks++;
+			tot->nchars += blk->blklist.blk[from].nchars;
+			tot->nlines += blk->blklist.blk[from].nlines;
 		}
-		return blklist;
 	}
+}
 
-	/* the doomed lblkno is in this block.  Free the char block */
-	(void)seslock(blklist, ElvFalse, SES_BLKLIST);
-	blk = sesblk(blklist);
-	assert(blk->blklist.blk[lblkno].blkno != 0);
-	sesfree(blk->blklist.blk[lblkno].blkno);
-
-	/* copy the chars & lines counts to caller's variables */
-	if (ncharsptr) *ncharsptr = blk->blklist.blk[lblkno].nchars;
-	if (nlinesptr) *nlinesptr = blk->blklist.blk[lblkno].nlines;
-
-	/* If it is the only block in this blklist (and, by implication,
-	 * this is the final blklist), then free the blklist block.
+/* This function inserts an entry into a BLKLIST or BLKTREE block which is
+ * already locked for writing.  If the block is full, then it is split and
+ * the new right half is described by *split; otherwise split->child is 0.
+ */
+static void insentry(blk, height, pos, entry, split)
+	BLK	*blk;	/* contents of the block, locked for writing */
+	long	height;	/* height of the block; 0 for BLKLIST */
+	int	pos;	/* index where the entry should be inserted */
+	char	*entry;	/* the new struct blki_s or struct blkt_s */
+	struct blkt_s *split; /* output: the new right half, if split */
+{
+	BLK	*into;	/* the half where the entry should be inserted */
+	BLK	*rblk;	/* contents of the new right half */
+	BLKNO	right;	/* the new right half */
+	int	n;	/* number of entries in "into" */
+	int	keep;	/* number of entries kept in the left half */
+	size_t	size = ENTRYSIZE(height);
+
+	n = nentries(blk, height);
+	assert(pos >= 0 && pos <= n);
+	split->child = 0;
+	into = blk;
+
+	/* if full, then split it.  Inserting at either end leaves the old
+	 * entries together, so appending a long series of blocks (as when a
+	 * file is loaded) leaves the blocks full.  Otherwise split evenly.
 	 */
-	if (lblkno == 0 && blk->blklist.blk[1].blkno == 0)
+	if (n >= MAXENTRY(height))
 	{
-		sesunlock(blklist, ElvFalse);
-		sesfree(blklist);
-		return 0;
+		keep = (pos == n) ? n : (pos == 0) ? 0 : n / 2;
+		right = seslock(sesalloc(0, NODETYPE(height)), ElvTrue, NODETYPE(height));
+		rblk = sesblk(right);
+		if (height > 0)
+			rblk->blktree.height = height;
+		memcpy(ENTRY(rblk, height, 0), ENTRY(blk, height, keep), (n - keep) * size);
+		memset(ENTRY(blk, height, keep), 0, (n - keep) * size);
+		if (pos > keep || (pos == keep && keep == n))
+		{
+			into = rblk;
+			pos -= keep;
+			n -= keep;
+		}
+		else
+		{
+			n = keep;
+		}
+
+		/* insert the entry, and then describe the right half */
+		memmove(ENTRY(into, height, pos + 1), ENTRY(into, height, pos), (n - pos) * size);
+		memcpy(ENTRY(into, height, pos), entry, size);
+		subtotal(rblk, height, 0, nentries(rblk, height), split);
+		split->child = right;
+		sesunlock(right, ElvTrue);
+		sesflush(right);
+		return;
 	}
-	sesunlock(blklist, ElvFalse);
 
-	/* shift this blklist's blk[] array to delete the element */
-	blklist = seslock(blklist, ElvTrue, SES_BLKLIST);
-	blk = sesblk(blklist);
-	while (lblkno < SES_MAXBLKLIST - 1)
+	/* there's room, so just insert it */
+	memmove(ENTRY(into, height, pos + 1), ENTRY(into, height, pos), (n - pos) * size);
+	memcpy(ENTRY(into, height, pos), entry, size);
+}
+
+/* This function tries to merge the subtree described by kid[i + 1] of a
+ * BLKTREE block into the subtree described by kid[i].  This only works if
+ * their entries will fit into a single block.  Returns ElvTrue if merged,
+ * in which case the caller should delete kid[i + 1].
+ */
+static ELVBOOL mergekids(blk, height, i)
+	BLK	*blk;	/* contents of a BLKTREE block, locked for writing */
+	long	height;	/* height of the BLKTREE block */
+	int	i;	/* index of the left subtree */
+{
+	struct blkt_s *kid = &blk->blktree.kid[i];
+	BLKNO	left, right;
+	BLK	*lblk, *rblk;
+	int	nleft, nright;
+
+	/* count the entries in each subtree; give up if too many */
+	left = kid[0].child;
+	right = kid[1].child;
+	assert(left != 0 && right != 0);
+	(void)seslock(left, ElvFalse, NODETYPE(height - 1));
+	nleft = nentries(sesblk(left), height - 1);
+	(void)seslock(right, ElvFalse, NODETYPE(height - 1));
+	rblk = sesblk(right);
+	nright = nentries(rblk, height - 1);
+	sesunlock(left, ElvFalse);
+	if (nleft + nright > MAXENTRY(height - 1))
 	{
-		blk->blklist.blk[lblkno] = blk->blklist.blk[lblkno + 1];
-		lblkno++;
+		sesunlock(right, ElvFalse);
+		return ElvFalse;
 	}
 
-	/* shift in a 0 (in the last block) or the first item from the
-	 * next blklist block.
+	/* append the right subtree's entries to the left subtree.  If the
+	 * right subtree is shared, then its entries gain a reference;
+	 * otherwise they're simply moved.
 	 */
-	if (blk->blklist.next == 0)
+	left = locknode(left, height - 1);
+	lblk = sesblk(left);
+	memcpy(ENTRY(lblk, height - 1, nleft), ENTRY(rblk, height - 1, 0),
+		nright * ENTRYSIZE(height - 1));
+	sesunlock(left, ElvTrue);
+	sesflush(left);
+	if (sesrefs(right) > 1)
+		addrefs(rblk, height - 1, 0, nright);
+	sesunlock(right, ElvFalse);
+	sesfree(right);
+
+	/* adjust the totals */
+	kid[0].child = left;
+	kid[0].nblks += kid[1].nblks;
+	kid[0].nchars += kid[1].nchars;
+	kid[0].nlines += kid[1].nlines;
+	return ElvTrue;
+}
+
+/* This function descends through a buffer's tree, to find the BLKLIST block
+ * which contains a given logical block, character offset, or line.  The totals
+ * for all CHARS blocks before that BLKLIST block are stored in *before.  If
+ * the wanted value is past the end of the buffer, then the last BLKLIST block
+ * is returned.  Returns 0 if the buffer has no blocks.
+ */
+static BLKNO descend(bufinfo, key, want, before)
+	_BLKNO_	bufinfo;	/* a BUFINFO block */
+	int	key;		/* one of BY_LBLKNO, BY_OFFSET, or BY_LINE */
+	long	want;		/* the wanted block, offset, or newline count */
+	struct blkt_s *before;	/* output: totals of preceding CHARS blocks */
+{
+	BLKNO	node, next;
+	BLK	*blk;
+	long	height;
+	int	i, n;
+	register struct blkt_s *kid;
+
+	/* find the root of the tree */
+	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
+	blk = sesblk(bufinfo);
+	node = blk->bufinfo.first;
+	height = blk->bufinfo.height;
+	sesunlock(bufinfo, ElvFalse);
+
+	before->child = 0;
+	before->nblks = 0;
+	before->nchars = before->nlines = 0L;
+
+	/* for each level of BLKTREE blocks... */
+	for (; height > 0; height--, node = next)
+	{
+		assert(node != 0);
+		(void)seslock(node, ElvFalse, SES_BLKTREE);
+		blk = sesblk(node);
+
+		/* skip any subtrees that end before the wanted value, but
+		 * never skip the last subtree.
+		 */
+		n = nentries(blk, height);
+		for (i = 0, kid = blk->blktree.kid; i < n - 1; i++, kid++)
+		{
+			if (key == BY_LBLKNO ? want < (long)(before->nblks + kid->nblks)
+			  : key == BY_OFFSET ? want < before->nchars + kid->nchars
+			  : want <= before->nlines + kid->nlines)
+				break;
+			before->nblks += kid->nblks;
+			before->nchars += kid->nchars;
+			before->nlines += kid->nlines;
+		}
+		next = kid->child;
+		sesunlock(node, ElvFalse);
+	}
+	return node;
+}
+
+/* This function updates the blki entry for a given logical block, changing
+ * its BLKNO (if "blkno" isn't 0) and adjusting its counts.  The totals in
+ * each BLKTREE block along the way are adjusted too.  Returns the BLKNO of
+ * the updated node.  This function is recursive.
+ */
+static BLKNO chgblock(node, height, lblkno, blkno, chgchars, chglines)
+	_BLKNO_	node;		/* a BLKLIST or BLKTREE block */
+	long	height;		/* height of node; 0 for BLKLIST */
+	_LBLKNO_ lblkno;	/* logical block number, relative to node */
+	_BLKNO_	blkno;		/* new BLKNO of the CHARS block, or 0 */
+	int	chgchars;	/* change in the number of characters */
+	int	chglines;	/* change in the number of lines */
+{
+	struct blki_s	*blki;
+	struct blkt_s	*kid;
+	BLKNO		locked;
+
+	assert(node != 0);
+	locked = locknode(node, height);
+	if (height > 0)
 	{
-		/* shift in a 0 */
-		blk->blklist.blk[lblkno].blkno = 0;
-		blk->blklist.blk[lblkno].nchars = 0;
-		blk->blklist.blk[lblkno].nlines = 0;
+		/* find the subtree, and update it recursively */
+		for (kid = sesblk(locked)->blktree.kid; lblkno >= kid->nblks; kid++)
+		{
+			assert(kid->child != 0);
+			lblkno -= kid->nblks;
+		}
+		kid->child = chgblock(kid->child, height - 1, lblkno, blkno, chgchars, chglines);
+		kid->nchars += chgchars;
+		kid->nlines += chglines;
 	}
 	else
 	{
-		/* shift in the first element of the next blklist's blk[] */
-		next = blk->blklist.next;
-		(void)seslock(next, ElvFalse, SES_BLKLIST);
-		blk->blklist.blk[lblkno] = sesblk(next)->blklist.blk[0];
-		sesalloc(blk->blklist.blk[lblkno].blkno, SES_CHARS);
-		sesunlock(next, ElvFalse);
-
-		/* recursively shift following blklists' blk[] arrays */
-		blk->blklist.next = delblock(next, 0, (COUNT *)0, (COUNT *)0);
+		/* update the entry itself */
+		assert(lblkno < SES_MAXBLKLIST);
+		blki = &sesblk(locked)->blklist.blk[lblkno];
+		assert(blki->blkno != 0);
+		if (blkno)
+			blki->blkno = blkno;
+		blki->nchars += chgchars;
+		assert(blki->nchars != 0 && blki->nchars < SES_MAXCHARS);
+		blki->nlines += chglines;
+		assert(blki->nlines < SES_MAXCHARS);
 	}
-
-	/* return BLKNO of altered version of this blklist */
-	sesunlock(blklist, ElvTrue);
-	return blklist;
+	sesunlock(locked, ElvTrue);
+	if (locked != node)
+		sesflush(locked);
+	return locked;
 }
 
-/* This function inserts a CHARS block into the blklist, at a given LBLKNO.
- * If necessary, it will also allocate a new BLKLIST block to extend the
- * blklist.
- *
- * This function is recursive; each invocation returns the blklist argument,
- * or the blkno of an updated version of that block.
+/* This function deletes one whole CHARS block from a subtree, and stores
+ * the deleted block's blki entry in *deleted.  It also stores the number of
+ * entries left in the node in *nleft; if that is 0, then the node has been
+ * freed.  Returns the BLKNO of the altered version of the node, or 0 if it
+ * was freed.  This function is recursive.
  */
-static BLKNO insblock(blklist, before, chars, nchars, nlines)
-	_BLKNO_	blklist;	/* a BLKLIST */
-	_LBLKNO_ before;	/* where to insert a block */
-	_BLKNO_	chars;		/* the CHARS block to be inserted */
-	_COUNT_	nchars;		/* number of character in "chars" */
-	_COUNT_	nlines;		/* number of lines in "chars" */
+static BLKNO delblock(node, height, lblkno, deleted, nleft)
+	_BLKNO_	node;		/* a BLKLIST or BLKTREE block */
+	long	height;		/* height of node; 0 for BLKLIST */
+	_LBLKNO_ lblkno;	/* logical block number, relative to node */
+	struct blki_s *deleted;	/* output: info about the deleted block */
+	int	*nleft;		/* output: number of entries left in node */
 {
-	BLKNO	next;	/* the block after blklist */
-	BLK	*blk;	/* contents of a BUFINFO or BLKLIST block */
-	int	i;
+	BLK	*blk;
+	struct blkt_s *kid;
+	int	i, n, sub;
+	int	doomed;		/* index of entry to remove, or -1 */
+	BLKNO	locked;
 
-	assert(chars != 0 && nchars != 0 && nchars < SES_MAXCHARS && nlines <= nchars);
+	assert(node != 0);
+	locked = locknode(node, height);
+	blk = sesblk(locked);
+	n = nentries(blk, height);
 
-	/* if no blklist, then create one */
-	if (!blklist)
+	if (height > 0)
 	{
-		assert(before == 0);
+		/* find the subtree, and delete from it recursively */
+		for (i = 0, kid = blk->blktree.kid; lblkno >= kid->nblks; i++, kid++)
+		{
+			assert(i < n);
+			lblkno -= kid->nblks;
+		}
+		kid->child = delblock(kid->child, height - 1, lblkno, deleted, &sub);
+		kid->nblks--;
+		kid->nchars -= deleted->nchars;
+		kid->nlines -= deleted->nlines;
 
-		/* give the buffer its first blkno */
-		blklist = sesalloc(0, SES_BLKLIST);
+		/* If the subtree is now empty, remove it.  If it is less than
+		 * half full, then try to merge it with a neighbor.
+		 */
+		if (!kid->child)
+			doomed = i;
+		else if (sub >= MAXENTRY(height - 1) / 2)
+			doomed = -1;
+		else if (i + 1 < n && mergekids(blk, height, i))
+			doomed = i + 1;
+		else if (i > 0 && mergekids(blk, height, i - 1))
+			doomed = i;
+		else
+			doomed = -1;
+	}
+	else
+	{
+		/* the doomed lblkno is in this block.  Free the CHARS block */
+		assert(lblkno < (unsigned)n);
+		*deleted = blk->blklist.blk[lblkno];
+		sesfree(deleted->blkno);
+		doomed = (int)lblkno;
+	}
 
-		/* make the new CHARS block be its first entry */
-		(void)seslock(blklist, ElvTrue, SES_BLKLIST);
-		blk = sesblk(blklist);
-		blk->blklist.blk[0].blkno = chars;
-		blk->blklist.blk[0].nchars = nchars;
-		blk->blklist.blk[0].nlines = nlines;
-		sesunlock(blklist, ElvTrue);
+	/* remove the doomed entry, if any */
+	if (doomed >= 0)
+	{
+		memmove(ENTRY(blk, height, doomed), ENTRY(blk, height, doomed + 1),
+			(n - doomed - 1) * ENTRYSIZE(height));
+		memset(ENTRY(blk, height, n - 1), 0, ENTRYSIZE(height));
+		n--;
 	}
-	/* should the chars block be inserted into this blklist block? */
-	else if (before < SES_MAXBLKLIST)
+
+	/* if the node is now empty, then free it */
+	*nleft = n;
+	if (n == 0)
 	{
-		/* yes!  Get this blocklist block */
-		blklist = seslock(blklist, ElvTrue, SES_BLKLIST);
-		blk = sesblk(blklist);
+		sesunlock(locked, ElvFalse);
+		sesfree(locked);
+		return 0;
+	}
+	sesunlock(locked, ElvTrue);
+	if (locked != node || (height > 0 && doomed >= 0))
+		sesflush(locked);
+	return locked;
+}
 
-		/* if the blklist is full, then insert the last item of
-		 * this block before the first item in the next block.
-		 */
-		i = SES_MAXBLKLIST - 1;
-		if (blk->blklist.blk[i].blkno)
-		{
-			blk->blklist.next = insblock(blk->blklist.next, 0,
-				blk->blklist.blk[i].blkno,
-				blk->blklist.blk[i].nchars,
-				blk->blklist.blk[i].nlines);
-		}
+/* This function deletes one whole CHARS block from a buffer, and stores the
+ * deleted block's blki entry in *deleted.  The tree gets shorter whenever
+ * its root is left with only a single subtree.  The old root blocks are
+ * added to oldroot[], and lowdelete() frees them after flushing the bufinfo.
+ */
+static void delroot(binfo, lblkno, deleted)
+	BLK	*binfo;		/* contents of a BUFINFO block, locked for writing */
+	_LBLKNO_ lblkno;	/* logical block number of the doomed block */
+	struct blki_s *deleted;	/* output: info about the deleted block */
+{
+	BLKNO	root, child;
+	BLK	*blk;
+	int	n;
 
-		/* insert the chars block into this blklist block */
-		for (; (unsigned)i > before; --i)
+	/* deleting the only block leaves the tree empty.  If the root is
+	 * shared then other versions still use it, so just drop this version's
+	 * reference to it.
+	 */
+	root = binfo->bufinfo.first;
+	if (binfo->bufinfo.height == 0 && noldroots < MAXOLDROOT)
+	{
+		(void)seslock(root, ElvFalse, SES_BLKLIST);
+		blk = sesblk(root);
+		n = nentries(blk, 0);
+		*deleted = blk->blklist.blk[0];
+		sesunlock(root, ElvFalse);
+		if (n == 1)
 		{
-			blk->blklist.blk[i] = blk->blklist.blk[i - 1];
+			assert(lblkno == 0);
+			if (sesrefs(root) > 1)
+				sesfree(root);
+			else
+			{
+				sesfree(deleted->blkno);
+				oldroot[noldroots++] = root;
+			}
+			binfo->bufinfo.first = 0;
+			return;
 		}
-		blk->blklist.blk[before].blkno = chars;
-		blk->blklist.blk[before].nchars = nchars;
-		blk->blklist.blk[before].nlines = nlines;
+	}
 
-		/* done! */
-		sesunlock(blklist, ElvTrue);
+	root = delblock(binfo->bufinfo.first, binfo->bufinfo.height, lblkno, deleted, &n);
+	while (root && binfo->bufinfo.height > 0 && n == 1 && noldroots < MAXOLDROOT)
+	{
+		(void)seslock(root, ElvFalse, SES_BLKTREE);
+		child = sesblk(root)->blktree.kid[0].child;
+		sesunlock(root, ElvFalse);
+		oldroot[noldroots++] = root;
+		root = child;
+		binfo->bufinfo.height--;
+
+		(void)seslock(root, ElvFalse, NODETYPE(binfo->bufinfo.height));
+		n = nentries(sesblk(root), binfo->bufinfo.height);
+		sesunlock(root, ElvFalse);
 	}
-	else /* chars will be inserted into a later blklist block */
+	if (!root)
+		binfo->bufinfo.height = 0;
+	binfo->bufinfo.first = root;
+}
+
+/* This function inserts a CHARS block into a subtree, before a given logical
+ * block.  If the node must be split, then the new right half is described by
+ * *split; otherwise split->child is 0.  Returns the BLKNO of the altered
+ * version of the node.  This function is recursive.
+ */
+static BLKNO insblock(node, height, before, blki, split)
+	_BLKNO_	node;		/* a BLKLIST or BLKTREE block */
+	long	height;		/* height of node; 0 for BLKLIST */
+	_LBLKNO_ before;	/* where to insert, relative to node */
+	struct blki_s *blki;	/* the new CHARS block and its counts */
+	struct blkt_s *split;	/* output: the new right half, if split */
+{
+	BLK	*blk;
+	struct blkt_s *kid, sub;
+	int	i, n;
+	BLKNO	locked;
+
+	assert(node != 0);
+	locked = locknode(node, height);
+	blk = sesblk(locked);
+	if (height > 0)
 	{
-		blklist = seslock(blklist, ElvTrue, SES_BLKLIST);
-		blk = sesblk(blklist);
-		next = insblock(blk->blklist.next, (LBLKNO)(before - SES_MAXBLKLIST), chars, nchars, nlines);
-		if (blk->blklist.next != next)
+		/* find the subtree.  If the new block goes between two
+		 * subtrees, then add it to the end of the first one.
+		 */
+		n = nentries(blk, height);
+		for (i = 0, kid = blk->blktree.kid; i < n - 1 && before > kid->nblks; i++, kid++)
+		{
+			before -= kid->nblks;
+		}
+		assert(before <= kid->nblks);
+
+		/* insert it recursively */
+		kid->child = insblock(kid->child, height - 1, before, blki, &sub);
+		kid->nblks++;
+		kid->nchars += blki->nchars;
+		kid->nlines += blki->nlines;
+
+		/* if the subtree was split, then add its right half here */
+		if (sub.child)
 		{
-			blk->blklist.next = next;
-			sesunlock(blklist, ElvTrue);
+			kid->nblks -= sub.nblks;
+			kid->nchars -= sub.nchars;
+			kid->nlines -= sub.nlines;
+			insentry(blk, height, i + 1, (char *)&sub, split);
 		}
 		else
 		{
-			sesunlock(blklist, ElvFalse);
+			split->child = 0;
 		}
 	}
-	return blklist;
+	else
+	{
+		insentry(blk, height, (int)before, (char *)blki, split);
+	}
+	sesunlock(locked, ElvTrue);
+	if (locked != node || split->child || (height > 0 && sub.child))
+		sesflush(locked);
+	return locked;
+}
+
+/* This function inserts a CHARS block into a buffer, before a given logical
+ * block.  The tree gets taller whenever its root is split.
+ */
+static void insroot(binfo, before, chars, nchars, nlines)
+	BLK	*binfo;		/* contents of a BUFINFO block, locked for writing */
+	_LBLKNO_ before;	/* where to insert a block */
+	_BLKNO_	chars;		/* the CHARS block to be inserted */
+	_COUNT_	nchars;		/* number of character in "chars" */
+	_COUNT_	nlines;		/* number of lines in "chars" */
+{
+	struct blki_s	blki;
+	struct blkt_s	split;
+	BLKNO	root, newroot;
+	BLK	*blk;
+	long	height;
+
+	assert(chars != 0 && nchars != 0 && nchars < SES_MAXCHARS && nlines <= nchars);
+	blki.blkno = chars;
+	blki.nchars = nchars;
+	blki.nlines = nlines;
+
+	/* if no blklist, then create one */
+	root = binfo->bufinfo.first;
+	height = binfo->bufinfo.height;
+	if (!root)
+	{
+		assert(before == 0);
+		root = seslock(sesalloc(0, SES_BLKLIST), ElvTrue, SES_BLKLIST);
+		sesblk(root)->blklist.blk[0] = blki;
+		sesunlock(root, ElvTrue);
+		sesflush(root);
+		binfo->bufinfo.first = root;
+		binfo->bufinfo.height = 0;
+		return;
+	}
+
+	/* insert it.  If the root is split, then add a new root above it */
+	root = insblock(root, height, before, &blki, &split);
+	if (split.child)
+	{
+		newroot = seslock(sesalloc(0, SES_BLKTREE), ElvTrue, SES_BLKTREE);
+		blk = sesblk(newroot);
+		blk->blktree.height = height + 1;
+		(void)seslock(root, ElvFalse, NODETYPE(height));
+		subtotal(sesblk(root), height, 0, nentries(sesblk(root), height), &blk->blktree.kid[0]);
+		sesunlock(root, ElvFalse);
+		blk->blktree.kid[0].child = root;
+		blk->blktree.kid[1] = split;
+		sesunlock(newroot, ElvTrue);
+		sesflush(newroot);
+		root = newroot;
+		height++;
+	}
+	binfo->bufinfo.first = root;
+	binfo->bufinfo.height = height;
+}
+
+/* This function drops a reference to a subtree.  If that was the last
+ * reference, then the subtree's own references are dropped too, so any
+ * blocks which aren't shared with another version are freed.  This function
+ * is recursive.
+ */
+static void freetree(node, height)
+	_BLKNO_	node;	/* a BLKLIST or BLKTREE block */
+	long	height;	/* height of node; 0 for BLKLIST */
+{
+	BLK	*blk;
+	int	i, n;
+
+	(void)seslock(node, ElvFalse, NODETYPE(height));
+	blk = sesblk(node);
+	n = sesrefs(node) > 1 ? 0 : nentries(blk, height);
+	for (i = 0; i < n; i++)
+	{
+		if (height > 0)
+			freetree(blk->blktree.kid[i].child, height - 1);
+		else
+			sesfree(blk->blklist.blk[i].blkno);
+	}
+	sesunlock(node, ElvFalse);
+	sesfree(node);
 }
 
 /* This function locks a CHARS block for writing.  Doing this may require
- * doing a copy-on-write, which may in turn require doing a copy-on-write
- * of the blklist block which refers to the CHARS block, and so on back to
- * the bufinfo block.  Returns the BLKNO of the CHARS block.
+ * doing a copy-on-write, in which case the blklist block which refers to the
+ * CHARS block must be updated.  The path to the CHARS block is copied first
+ * if it is shared with another version of the buffer, since a CHARS block
+ * in a shared BLKLIST block is shared too even though it has only one
+ * reference.  Returns the BLKNO of the CHARS block.
  */
 static BLKNO lockchars(bufinfo, lblkno, blkno)
 	_BLKNO_	bufinfo;	/* a BUFINFO block */
-	_LBLKNO_ lblkno;	/* index info BLKLIST of the CHARS block */
+	_LBLKNO_ lblkno;	/* logical block number of the CHARS block */
 	_BLKNO_	blkno;		/* physical block number of the CHARS block */
 {
 	BLKNO	locked;		/* BLKNO of various blocks after locking */
-	BLKNO	blklist, next;	/* BLKLIST blocks */
+	BLKNO	root;		/* root of the tree, after updating */
 	BLK	*blk;
 
 	assert(bufinfo != 0 && blkno != 0);
@@ -264,7 +721,27 @@ static BLKNO lockchars(bufinfo, lblkno, blkno)
 	scan__nobuf();
 #endif
 
-	/* step 1: lock the chars block.  If its BLKNO remains unchanged,
+	/* step 1: make sure the path to the chars block isn't shared.  If
+	 * the root changes, then store it in the bufinfo block.
+	 */
+	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
+	blk = sesblk(bufinfo);
+	root = chgblock(blk->bufinfo.first, blk->bufinfo.height, lblkno, 0, 0, 0);
+	if (root != blk->bufinfo.first)
+	{
+		sesunlock(bufinfo, ElvFalse);
+		(void)seslock(bufinfo, ElvTrue, SES_BUFINFO);
+		blk = sesblk(bufinfo);
+		blk->bufinfo.first = root;
+		blk->bufinfo.checksum = checksum(blk);
+		sesunlock(bufinfo, ElvTrue);
+	}
+	else
+	{
+		sesunlock(bufinfo, ElvFalse);
+	}
+
+	/* step 2: lock the chars block.  If its BLKNO remains unchanged,
 	 * then we're done.
 	 */
 	locked = seslock(blkno, ElvTrue, SES_CHARS);
@@ -273,48 +750,30 @@ static BLKNO lockchars(bufinfo, lblkno, blkno)
 		return blkno;
 	}
 
-	/* step 2: fetch the bufinfo block. */
-	next = seslock(bufinfo, ElvFalse, SES_BUFINFO);
-	assert(next == bufinfo);
-	blk = sesblk(bufinfo);
-
-	/* step 3: lock the blklist block which contains the requested
-	 * chars block.  Since blklist blocks are never shared, this
-	 * shouldn't require copy-on-write.
+	/* step 3: store the new BLKNO in the blklist.  Since the path is no
+	 * longer shared, this won't require copy-on-write.
 	 */
-	blklist = seslock(blk->bufinfo.first, ElvTrue, SES_BLKLIST);
-	blk = sesblk(blklist);
-	while (lblkno >= SES_MAXBLKLIST)
-	{
-		next = seslock(blk->blklist.next, ElvTrue, SES_BLKLIST);
-		assert(next != 0);
-		sesunlock(blklist, ElvFalse);
-		blklist = next;
-		lblkno -= SES_MAXBLKLIST;
-		blk = sesblk(blklist);
-	}
-	assert(blk->blklist.blk[lblkno].blkno == blkno);
-
-	/* step 4: replace the blkno in the blklist */
-	blk->blklist.blk[lblkno].blkno = locked;
-	sesunlock(blklist, ElvTrue);
+	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
+	blk = sesblk(bufinfo);
+	root = chgblock(blk->bufinfo.first, blk->bufinfo.height, lblkno, locked, 0, 0);
+	assert(root == blk->bufinfo.first);
 	sesunlock(bufinfo, ElvFalse);
 	return locked;
 }
 
 /* This function unlocks a CHARS block which has been locked by lockchars(),
- * and then updates the nchars and nlines statistics in the blklist block.
- * It is assumed that no copy-on-write will be necessary for the blklist block;
- * if it was, lockchars() would have done it.
+ * and then updates the nchars and nlines statistics in the blklist block and
+ * the blktree blocks above it.  It is assumed that no copy-on-write will be
+ * necessary for them; if it was, lockchars() would have done it.
  */
 static void unlockchars(bufinfo, lblkno, blkno, chgchars, chglines)
 	_BLKNO_	bufinfo;	/* a BUFINFO block */
-	_LBLKNO_ lblkno;	/* index into BLKLIST of the CHARS block */
+	_LBLKNO_ lblkno;	/* logical block number of the CHARS block */
 	_BLKNO_	blkno;		/* physical block number of CHARS block */
 	int	chgchars;	/* change in the number of characters */
 	int	chglines;	/* change in the number of lines */
 {
-	BLKNO	blklist, next;
+	BLKNO	root;
 	BLK	*blk;
 
 	assert(bufinfo != 0 && blkno != 0);
@@ -322,31 +781,11 @@ static void unlockchars(bufinfo, lblkno, blkno, chgchars, chglines)
 	/* update block statistics, if necessary */
 	if (chgchars != 0 || chglines != 0)
 	{
-		/* locate the BLKLIST block that refers to this CHARS block */
 		(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
-		blklist = sesblk(bufinfo)->bufinfo.first;
-		assert(blklist != 0);
+		blk = sesblk(bufinfo);
+		root = chgblock(blk->bufinfo.first, blk->bufinfo.height, lblkno, 0, chgchars, chglines);
+		assert(root == blk->bufinfo.first);
 		sesunlock(bufinfo, ElvFalse);
-		for (; lblkno >= SES_MAXBLKLIST; lblkno -= SES_MAXBLKLIST)
-		{
-			(void)seslock(blklist, ElvFalse, SES_BLKLIST);
-			next = sesblk(blklist)->blklist.next;
-			sesunlock(blklist, ElvFalse);
-			blklist = next;
-			assert(blklist != 0);
-		}
-
-		/* update the nchars and nlines counts */
-		next = seslock(blklist, ElvTrue, SES_BLKLIST);
-		assert(next == blklist);
-		blk = sesblk(blklist);
-		blk->blklist.blk[lblkno].nchars += chgchars;
-		assert(blk->blklist.blk[lblkno].nchars != 0
-			&& blk->blklist.blk[lblkno].nchars < SES_MAXCHARS);
-		blk->blklist.blk[lblkno].nlines += chglines;
-		assert(blk->blklist.blk[lblkno].nlines < SES_MAXCHARS);
-		assert(blk->blklist.blk[lblkno].blkno == blkno);
-		sesunlock(blklist, ElvTrue);
 	}
 
 	/* unlock the chars block for writing */
@@ -357,6 +796,96 @@ static void unlockchars(bufinfo, lblkno, blkno, chgchars, chglines)
 /* session restarting function                                                */
 
 #ifdef FEATURE_MISC
+/* This function helps helpinit(), by marking all blocks in a subtree as
+ * being "allocated", and adding up its characters and lines.  If elvis
+ * crashed, then some of the tree's blocks may not have been written since
+ * their last change, so a subtree's totals are recounted from its CHARS
+ * blocks and any stale totals in the node are corrected.  Returns ElvFalse
+ * if the node doesn't look like a BLKLIST or BLKTREE block of the expected
+ * height, since that means it has been reused for something else.  A
+ * subtree which is shared by several versions of a buffer is only checked
+ * the first time it is found.  This function is recursive.
+ */
+static ELVBOOL inittree(node, height, tot)
+	_BLKNO_	node;		/* a BLKLIST or BLKTREE block */
+	long	height;		/* height of node; 0 for BLKLIST */
+	struct blkt_s *tot;	/* output: actual totals of the subtree */
+{
+	BLKNO	next;
+	BLK	*blk;
+	struct blkt_s sub, *kid;
+	ELVBOOL	shared;
+	int	i, n;
+
+	/* mark the node as being "allocated", & lock it */
+	shared = (ELVBOOL)(sesrefs(node) > 0);
+	(void)seslock(sesalloc(node, NODETYPE(height)), ElvFalse, NODETYPE(height));
+	blk = sesblk(node);
+	n = nentries(blk, height);
+
+	/* check the node's type, and the CHARS entries in a BLKLIST */
+	if (height > 0 ? blk->blktree.height != height : blk->blklist.next != 0)
+	{
+		sesunlock(node, ElvFalse);
+		return ElvFalse;
+	}
+	if (shared)
+	{
+		subtotal(blk, height, 0, n, tot);
+		sesunlock(node, ElvFalse);
+		return ElvTrue;
+	}
+	for (i = 0; height == 0 && i < n; i++)
+	{
+		if (blk->blklist.blk[i].nchars == 0
+		 || blk->blklist.blk[i].nchars >= SES_MAXCHARS
+		 || blk->blklist.blk[i].nlines > blk->blklist.blk[i].nchars)
+		{
+			sesunlock(node, ElvFalse);
+			return ElvFalse;
+		}
+	}
+
+	/* for each subtree or CHARS block mentioned in it... */
+	for (i = 0; i < n; i++)
+	{
+		if (height > 0)
+		{
+			/* recount the subtree, and correct its totals if stale */
+			kid = &blk->blktree.kid[i];
+			if (!inittree(kid->child, height - 1, &sub))
+			{
+				sesunlock(node, ElvFalse);
+				return ElvFalse;
+			}
+			if (kid->nblks != sub.nblks
+			 || kid->nchars != sub.nchars
+			 || kid->nlines != sub.nlines)
+			{
+				sesunlock(node, ElvFalse);
+				(void)seslock(node, ElvTrue, SES_BLKTREE);
+				blk = sesblk(node);
+				kid = &blk->blktree.kid[i];
+				kid->nblks = sub.nblks;
+				kid->nchars = sub.nchars;
+				kid->nlines = sub.nlines;
+				sesunlock(node, ElvTrue);
+				(void)seslock(node, ElvFalse, SES_BLKTREE);
+			}
+			continue;
+		}
+
+		/* mark the CHARS block as being "allocated" */
+		next = sesalloc(blk->blklist.blk[i].blkno, SES_CHARS);
+		assert(next == blk->blklist.blk[i].blkno);
+	}
+
+	/* add up the node's totals, then unlock it */
+	subtotal(blk, height, 0, n, tot);
+	sesunlock(node, ElvFalse);
+	return ElvTrue;
+}
+
 /* This function helps lowinit(), by initializing a single buffer from the
  * session file.
  */
@@ -364,10 +893,9 @@ static void helpinit(bufinfo, bufproc)
 	_BLKNO_	bufinfo;	/* a BUFINFO block */
 	void	(*bufproc)P_((_BLKNO_ bufinfo, long nchars, long nlines, long changes, long prevloc, CHAR *name));
 {
-	BLKNO	blklist, next;
-	BLK	*binfo, *blist;
-	long	nchars = 0, nlines = 0;
-	int	i;
+	BLKNO	next;
+	BLK	*binfo;
+	struct blkt_s tot;
 
 	/* mark the bufinfo block as being "allocated", and lock it in memory */
 	next = sesalloc(bufinfo, SES_BUFINFO);
@@ -383,35 +911,30 @@ static void helpinit(bufinfo, bufproc)
 		return;
 	}
 
-	/* for each blklist block... */
-	for (blklist = binfo->bufinfo.first; blklist; blklist = next)
+	/* if its text was left in the original file, then it can't be
+	 * recovered from the session file.
+	 */
+	if (binfo->bufinfo.lazy)
 	{
-		/* mark the blklist block as being "allocated", & lock it */
-		(void)seslock(sesalloc(blklist, SES_BLKLIST), ElvFalse, SES_BLKLIST);
-		blist = sesblk(blklist);
-
-		/* For each chars block mentioned in the BLKLIST... */
-		for (i = 0; (unsigned)i < SES_MAXBLKLIST && blist->blklist.blk[i].blkno; i++)
-		{
-			assert(blist->blklist.blk[i].nchars < SES_MAXCHARS);
-			assert(blist->blklist.blk[i].nlines <= blist->blklist.blk[i].nchars);
-
-			/* mark the CHARS block as being "allocated" */
-			next = sesalloc(blist->blklist.blk[i].blkno, SES_CHARS);
-			assert(next == blist->blklist.blk[i].blkno);
-
-			/* count lines & chars in block */
-			nchars += blist->blklist.blk[i].nchars;
-			nlines += blist->blklist.blk[i].nlines;
-		}
+		fprintf(stderr, "\"%s\" was loaded lazily, so it can't be recovered\n", tochar8(binfo->bufinfo.name));
+		sesunlock(bufinfo, ElvFalse);
+		return;
+	}
 
-		/* find the next blklist, and then unlock this one */
-		next = blist->blklist.next;
-		sesunlock(blklist, ElvFalse);
+	/* mark the blocks in the tree as being "allocated", and count the
+	 * buffer's characters and lines.  If the tree is damaged, skip it.
+	 */
+	tot.nchars = tot.nlines = 0L;
+	if (binfo->bufinfo.first
+	 && !inittree(binfo->bufinfo.first, binfo->bufinfo.height, &tot))
+	{
+		fprintf(stderr, "found a bad version of \"%s\"\n", tochar8(binfo->bufinfo.name));
+		sesunlock(bufinfo, ElvFalse);
+		return;
 	}
 
 	/* let the BUFFER module initialize itself */
-	(*bufproc)(bufinfo, nchars, nlines, binfo->bufinfo.changes, binfo->bufinfo.prevloc, binfo->bufinfo.name);
+	(*bufproc)(bufinfo, tot.nchars, tot.nlines, binfo->bufinfo.changes, binfo->bufinfo.prevloc, binfo->bufinfo.name);
 
 	/* unlock the bufinfo block */
 	sesunlock(bufinfo, ElvFalse);
@@ -504,7 +1027,7 @@ BLKNO lowalloc(name)
 	blk = sesblk(bufinfo);
 	blk->bufinfo.changes = 0L;
 	blk->bufinfo.prevloc = 0L;
-	blk->bufinfo.reserved = 0;
+	blk->bufinfo.height = 0;
 	blk->bufinfo.first = 0;
 	CHARncpy(blk->bufinfo.name, name, (size_t)SES_MAXBUFINFO);
 	blk->bufinfo.checksum = checksum(blk);
@@ -569,10 +1092,8 @@ BLKNO lowalloc(name)
 BLKNO lowdup(originfo)
 	_BLKNO_	originfo;	/* BUFINFO block of original lowbuf */
 {
-	BLKNO	dupinfo, dupblklist, prevdup = 0;
-	BLKNO	scan, next;
-	BLK	*blk, *dupblk = NULL, *dupbiblk;
-	int	i;
+	BLKNO	dupinfo, scan;
+	BLK	*blk, *dupbiblk;
 
 #if LINECACHE
 	clobbercache(originfo);
@@ -596,53 +1117,12 @@ BLKNO lowdup(originfo)
 	/* Unlock the original bufinfo block */
 	sesunlock(originfo, ElvFalse);
 
-	/* For each blklist block... */
-	scan = blk->bufinfo.first;
-	while (scan)
-	{
-		/* allocate a new blklist block, for the new buffer */
-		dupblklist = sesalloc(0, SES_BLKLIST);
-
-		/* link the new blklist block into the new buffer's list */
-		if (prevdup != 0)
-		{
-			dupblk->blklist.next = dupblklist;
-			sesunlock(prevdup, ElvTrue);
-		}
-		else
-		{
-			dupbiblk->bufinfo.first = dupblklist;
-		}
-
-		/* Lock the blklist blocks */
-		(void)seslock(scan, ElvFalse, SES_BLKLIST);
-		blk = sesblk(scan);
-		next = seslock(dupblklist, ElvTrue, SES_BLKLIST);
-		assert(next == dupblklist);
-		dupblk = sesblk(dupblklist);
-		prevdup = dupblklist;
-
-		/* copy the contents from one blklist to the other */
-		memcpy(dupblk, blk, (size_t)o_blksize);
-
-		/* For each chars block... */
-		for (i = 0; (unsigned)i < SES_MAXBLKLIST && blk->blklist.blk[i].blkno; i++)
-		{
-			/* Increment allocation count on the chars block */
-			(void)sesalloc(blk->blklist.blk[i].blkno, SES_CHARS);
-		}
-		assert((unsigned)i == SES_MAXBLKLIST || !blk->blklist.next);
-
-		/* unlock the blklist blocks, and procede to next blklist */
-		next = blk->blklist.next;
-		sesunlock(scan, ElvFalse);
-		scan = next;
-	}
-
-	/* unlock the final new blklist block (if any) */
-	if (dupblk)
+	/* Share the tree of blklist blocks.  Blocks are copied later, as
+	 * either version changes them.
+	 */
+	if (dupbiblk->bufinfo.first)
 	{
-		sesunlock(prevdup, ElvTrue);
+		(void)sesalloc(dupbiblk->bufinfo.first, NODETYPE(dupbiblk->bufinfo.height));
 	}
 
 	/* Unlock the new bufinfo block for writing */
@@ -705,27 +1185,11 @@ void lowfree(bufinfo)
 	/* Lock the bufinfo block */
 	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
 
-	/* For each blklist block... */
-	for (scan = sesblk(bufinfo)->bufinfo.first; scan; scan = next)
+	/* Free the tree of blklist blocks, and the chars blocks */
+	blk = sesblk(bufinfo);
+	if (blk->bufinfo.first)
 	{
-		/* Lock the blklist block */
-		(void)seslock(scan, ElvFalse, SES_BLKLIST);
-
-		/* For each chars block... */
-		blk = sesblk(scan);
-		for (i = 0; (unsigned)i < SES_MAXBLKLIST && blk->blklist.blk[i].blkno; i++)
-		{
-			/* free the chars block */
-			sesfree(blk->blklist.blk[i].blkno);
-		}
-		assert((unsigned)i == SES_MAXBLKLIST || !blk->blklist.next);
-
-		/* Unlock the blklist block */
-		next = blk->blklist.next;
-		sesunlock(scan, ElvFalse);
-
-		/* Free the blklist block */
-		sesfree(scan);
+		freetree(blk->bufinfo.first, blk->bufinfo.height);
 	}
 
 	/* Unlock the bufinfo block */
@@ -788,12 +1252,13 @@ long lowline(bufinfo, lineno)
 	_BLKNO_	bufinfo;	/* BUFINFO of the buffer */
 	long	lineno;		/* line number (starting with 1) */
 {
-	BLK	*blk;	/* contents of a bufinfo block or blklist block */
-	BLKNO	blklist;/* used for stepping from one blklist to next */
-	BLKNO	next;	/* the next blklist block, after this one */
+	BLK	*blk;	/* contents of a blklist block or chars block */
+	BLKNO	blklist;/* the blklist block containing the line */
+	BLKNO	next;	/* the chars block containing the line */
 	long	offset;	/* total offset seen */
 	int	i;	/* used for scanning through blklist.blk[] */
 	int	nlines;	/* number of lines/chars in block */
+	struct blkt_s before; /* totals of blocks before blklist */
 #if LINECACHE
 	long	origline;/* a copy of lineno */
 
@@ -811,101 +1276,88 @@ long lowline(bufinfo, lineno)
 	/* outside this function, line numbers start with 1, but in here they start at 0 */
 	lineno--;
 
-	/* find the first blklist */
-	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
-	blklist = sesblk(bufinfo)->bufinfo.first;
-	sesunlock(bufinfo, ElvFalse);
+	/* find the blklist which contains the line */
+	blklist = descend(bufinfo, BY_LINE, lineno, &before);
 
 	/* if empty buffer then return 0 */
 	if (!blklist)
 	{
 		return 0;
 	}
+	lineno -= before.nlines;
+	offset = before.nchars;
 
-	/* for each blklist... */
-	for (offset = 0; ; blklist = next)
+	/* for each element of blklist->blk[]... */
+	seslock(blklist, ElvFalse, SES_BLKLIST);
+	blk = sesblk(blklist);
+	for (i = 0; (unsigned)i < SES_MAXBLKLIST && blk->blklist.blk[i].blkno; i++)
 	{
-		assert(blklist != 0);
-
-		/* for each element of blklist->blk[]... */
-		seslock(blklist, ElvFalse, SES_BLKLIST);
-		blk = sesblk(blklist);
-		for (i = 0; (unsigned)i < SES_MAXBLKLIST && blk->blklist.blk[i].blkno; i++)
+		/* see if we've found the right chars block yet */
+		if ((nlines = blk->blklist.blk[i].nlines) >= lineno)
 		{
-			/* see if we've found the right chars block yet */
-			if ((nlines = blk->blklist.blk[i].nlines) >= lineno)
+			/* unlock the blklist, and lock the chars block */
+			next = blk->blklist.blk[i].blkno;
+			i = blk->blklist.blk[i].nchars;
+			sesunlock(blklist, ElvFalse);
+			(void)seslock(next, ElvFalse, SES_CHARS);
+			blk = sesblk(next);
+
+			/* AT THIS POINT...
+			 * lineno = number of newlines to move past
+			 *          in this CHARS block.
+			 * nlines = total number of newlines in this
+			 *          CHARS block
+			 * i      = total chars in this CHARS block
+			 * offset = offset of start of this block
+			 */
+
+			/* locate the line within the chars block */
+			if (lineno + lineno <= nlines)
 			{
-				/* unlock the blklist, and lock the chars block */
-				next = blk->blklist.blk[i].blkno;
-				i = blk->blklist.blk[i].nchars;
-				sesunlock(blklist, ElvFalse);
-				(void)seslock(next, ElvFalse, SES_CHARS);
-				blk = sesblk(next);
-
-				/* AT THIS POINT...
-				 * lineno = number of newlines to move past
-				 *          in this CHARS block.
-				 * nlines = total number of newlines in this
-				 *          CHARS block
-				 * i      = total chars in this CHARS block
-				 * offset = offset of start of this block
-				 */
-
-				/* locate the line within the chars block */
-				if (lineno + lineno <= nlines)
+				/* count newlines from front of block */
+				for (i = 0; lineno > 0; offset++, i++)
 				{
-					/* count newlines from front of block */
-					for (i = 0; lineno > 0; offset++, i++)
+					assert((unsigned)i < SES_MAXCHARS);
+					if (blk->chars.chars[i] == '\n')
 					{
-						assert((unsigned)i < SES_MAXCHARS);
-						if (blk->chars.chars[i] == '\n')
-						{
-							lineno--;
-						}
+						lineno--;
 					}
 				}
-				else
+			}
+			else
+			{
+				/* count newlines from rear of block */
+				for (offset += i, lineno -= nlines; ; )
 				{
-					/* count newlines from rear of block */
-					for (offset += i, lineno -= nlines; ; )
+					assert(i > 0);
+					if (blk->chars.chars[--i]=='\n')
 					{
-						assert(i > 0);
-						if (blk->chars.chars[--i]=='\n')
-						{
-							if (lineno++ == 0)
-								break;
-						}
-						offset--;
+						if (lineno++ == 0)
+							break;
 					}
+					offset--;
 				}
+			}
 
 #if LINECACHE
-				/* stuff information into the cache */
-				linecache[lineidx].bufinfo = bufinfo;
-				linecache[lineidx].offset = offset;
-				linecache[lineidx].lineno = origline;
-				lineidx = (lineidx + 1) % LINECACHE;
+			/* stuff information into the cache */
+			linecache[lineidx].bufinfo = bufinfo;
+			linecache[lineidx].offset = offset;
+			linecache[lineidx].lineno = origline;
+			lineidx = (lineidx + 1) % LINECACHE;
 #endif /* LINECACHE */
 
-				/* return the offset */
-				sesunlock(next, ElvFalse);
-				return offset;
-			}
-			lineno -= blk->blklist.blk[i].nlines;
-			offset += blk->blklist.blk[i].nchars;
-		}
-
-		/* find the next blklist */
-		next = blk->blklist.next;
-		assert(!next || (unsigned)i == SES_MAXBLKLIST);
-		sesunlock(blklist, ElvFalse);
-		if (!next)
-		{
-			/* there is no next blklist block -- return final offset */
+			/* return the offset */
+			sesunlock(next, ElvFalse);
 			return offset;
 		}
+		lineno -= blk->blklist.blk[i].nlines;
+		offset += blk->blklist.blk[i].nchars;
 	}
-	/*NOTREACHED*/
+
+	/* past the end of the buffer -- return final offset */
+	sesunlock(blklist, ElvFalse);
+	return offset;
 }
 
 /******************************************************************************/
@@ -938,16 +1390,17 @@ BLKNO lowoffset(bufinfo, offset, left, right, lptr, linenum)
 	LBLKNO	*lptr;	 /* output: logical block number of CHARS block */
 	long	*linenum;/* output: line number */
 {
-	BLKNO	blklist;/* used for stepping from one blklist to next */
-	BLKNO	next;	/* the next blklist block, after this one */
+	BLKNO	blklist;/* the blklist block containing the offset */
+	BLKNO	next;	/* the chars block containing the offset */
 	LBLKNO	lblkno;	/* counts overall LBLKNO of the given offset */
 	long	lnum;	/* counts newlines */
-	BLK	*blk;	/* contents of a bufinfo or blklist block */
+	BLK	*blk;	/* contents of a blklist or chars block */
 	register int	i;	/* used for scanning through blklist.blk[] */
 	int	nlines;	/* lines in current CHARS block */
 	int	nchars;	/* chars in current CHARS block */
 	register struct blki_s *blki;
 	BLKNO	maxblklist = SES_MAXBLKLIST;
+	struct blkt_s before; /* totals of blocks before blklist */
 
 	/* treat negative offsets as 0 */
 	if (offset < 0)
@@ -955,10 +1408,8 @@ BLKNO lowoffset(bufinfo, offset, left, right, lptr, linenum)
 		offset = 0;
 	}
 
-	/* find the first blklist */
-	(void)seslock(bufinfo, ElvFalse, SES_BUFINFO);
-	blklist = sesblk(bufinfo)->bufinfo.first;
-	sesunlock(bufinfo, ElvFalse);
+	/* find the blklist which contains the offset */
+	blklist = descend(bufinfo, BY_OFFSET, offset, &before);
 
 	/* if the buffer has no blocks, then any offset is past the end of
 	 * the buffer, so do the "*right = 0" thing.
@@ -972,92 +1423,148 @@ BLKNO lowoffset(bufinfo, offset, left, right, lptr, linenum)
 		return 0;
 	}
 
-	/* for each blklist... */
-	for (lblkno = 0, lnum = 1; ; lblkno += maxblklist, blklist = next)
+	offset -= before.nchars;
+	lblkno = before.nblks;
+	lnum = 1 + before.nlines;
+
+	/* for each element of blklist->blk[]... */
+	seslock(blklist, ElvFalse, SES_BLKLIST);
+	blk = sesblk(blklist);
+	for (i = 0, blki = blk->blklist.blk;
+	     i < maxblklist && blki->blkno;
+	     lnum += blki->nlines, i++, blki++)
 	{
-		assert(blklist != 0);
-
-		/* for each element of blklist->blk[]... */
-		seslock(blklist, ElvFalse, SES_BLKLIST);
-		blk = sesblk(blklist);
-		for (i = 0, blki = blk->blklist.blk;
-		     i < maxblklist && blki->blkno;
-		     lnum += blki->nlines, i++, blki++)
+		/* see if we've found it yet */
+		offset -= blki->nchars;
+		if (offset < 0L)
 		{
-			/* see if we've found it yet */
-			offset -= blki->nchars;
-			if (offset < 0L)
+			/* Yes!  Return the info */
+			next = blki->blkno;
+			nlines = blki->nlines;
+			nchars = blki->nchars;
+			sesunlock(blklist, ElvFalse);
+			if (lptr) *lptr = lblkno + i;
+			i = offset + nchars;
+			if (left) *left = i;
+			if (right) *right = (unsigned short)-offset;
+			if (linenum)
 			{
-				/* Yes!  Return the info */
-				next = blki->blkno;
-				nlines = blki->nlines;
-				nchars = blki->nchars;
-				sesunlock(blklist, ElvFalse);
-				if (lptr) *lptr = lblkno + i;
-				i = offset + nchars;
-				if (left) *left = i;
-				if (right) *right = (unsigned short)-offset;
-				if (linenum)
+				/* AT THIS POINT...
+				 * lnum = line# of front of block
+				 * i    = index into block
+				 * nlines = total \n's in CHARS block
+				 * nchars = total chars in CHARS block
+				 * next   = BLKNO of the CHARS block
+				 */
+				if (i + i <= nchars)
 				{
-					/* AT THIS POINT...
-					 * lnum = line# of front of block
-					 * i    = index into block
-					 * nlines = total \n's in CHARS block
-					 * nchars = total chars in CHARS block
-					 * next   = BLKNO of the CHARS block
-					 */
-					if (i + i <= nchars)
+					/* count from front of block */
+					seslock(next, ElvFalse, SES_CHARS);
+					blk = sesblk(next);
+					while (--i >= 0)
 					{
-						/* count from front of block */
-						seslock(next, ElvFalse, SES_CHARS);
-						blk = sesblk(next);
-						while (--i >= 0)
+						if (blk->chars.chars[i] == '\n')
 						{
-							if (blk->chars.chars[i] == '\n')
-							{
-								lnum++;
-							}
+							lnum++;
 						}
-						sesunlock(next, ElvFalse);
 					}
-					else
+					sesunlock(next, ElvFalse);
+				}
+				else
+				{
+					/* count from rear of block */
+					lnum += nlines;
+					seslock(next, ElvFalse, SES_CHARS);
+					blk = sesblk(next);
+					do
 					{
-						/* count from rear of block */
-						lnum += nlines;
-						seslock(next, ElvFalse, SES_CHARS);
-						blk = sesblk(next);
-						do
+						if (blk->chars.chars[--nchars] == '\n')
 						{
-							if (blk->chars.chars[--nchars] == '\n')
-							{
-								lnum--;
-							}
-						} while (i < nchars);
-						sesunlock(next, ElvFalse);
-					}
-					*linenum = lnum;
+							lnum--;
+						}
+					} while (i < nchars);
+					sesunlock(next, ElvFalse);
 				}
-				return next;
+				*linenum = lnum;
 			}
+			return next;
 		}
+	}
+
+	/* past the end of the buffer -- do the "*right = 0" thing.  */
+	if (left) *left = blk->blklist.blk[i - 1].nchars;
+	if (right) *right = 0;
+	if (lptr) *lptr = lblkno + i - 1;
+	if (linenum) *linenum = lnum;
+	next = blk->blklist.blk[i - 1].blkno;
+	sesunlock(blklist, ElvFalse);
+	return next;
+}
+
+
+/* This function finds the CHARS blocks which follow (or precede) the one
+ * containing a given offset, so they can be read ahead.  Up to "max" BLKNOs
+ * are stored in blks[], in the order that a scan would reach them.  Returns
+ * the number of BLKNOs stored, which is less than "max" near the end (or
+ * front) of the buffer.
+ */
+int lowahead(bufinfo, offset, forward, blks, max)
+	_BLKNO_	bufinfo; /* BUFINFO of the lowbuf */
+	long	offset;	 /* offset of a character in the current block */
+	ELVBOOL	forward; /* ElvTrue for following blocks, ElvFalse for preceding */
+	BLKNO	*blks;	 /* output: blocks that will be scanned next */
+	int	max;	 /* size of the blks[] array */
+{
+	BLKNO	blklist;/* the blklist block being examined */
+	BLK	*blk;	/* contents of the blklist block */
+	long	lblkno;	/* logical block number of a neighboring blklist */
+	int	i, n;	/* index into blklist.blk[], and number of entries */
+	int	count;	/* number of BLKNOs stored so far */
+	struct blkt_s before; /* totals of blocks before blklist */
+
+	/* find the blklist which contains the offset */
+	blklist = descend(bufinfo, BY_OFFSET, offset, &before);
+	if (!blklist)
+		return 0;
+	seslock(blklist, ElvFalse, SES_BLKLIST);
+	blk = sesblk(blklist);
+	n = nentries(blk, 0);
+
+	/* find the entry for the block containing the offset */
+	offset -= before.nchars;
+	for (i = 0; i < n - 1 && offset >= blk->blklist.blk[i].nchars; i++)
+		offset -= blk->blklist.blk[i].nchars;
 
-		/* find the next blklist */
-		next = blk->blklist.next;
-		assert(!next || i == maxblklist);
-		if (!next)
+	/* collect the blocks after (or before) it */
+	for (count = 0; count < max; count++)
+	{
+		i += forward ? 1 : -1;
+
+		/* if we've stepped off this blklist, move to its neighbor */
+		if (i < 0 || i >= n)
 		{
-			/* there is no next blklist block -- do the "*right = 0" * thing.  */
-			if (left) *left = blk->blklist.blk[i - 1].nchars;
-			if (right) *right = 0;
-			if (lptr) *lptr = lblkno + i - 1;
-			if (linenum) *linenum = lnum;
-			next = blk->blklist.blk[i - 1].blkno;
 			sesunlock(blklist, ElvFalse);
-			return next;
+			lblkno = (long)before.nblks + (forward ? n : -1);
+			if (lblkno < 0)
+				return count;
+			blklist = descend(bufinfo, BY_LBLKNO, lblkno, &before);
+			if ((long)before.nblks > lblkno)
+				return count;
+			seslock(blklist, ElvFalse, SES_BLKLIST);
+			blk = sesblk(blklist);
+			n = nentries(blk, 0);
+			if ((long)before.nblks + n <= lblkno)
+			{
+				/* lblkno is past the end of the buffer */
+				sesunlock(blklist, ElvFalse);
+				return count;
+			}
+			i = (int)(lblkno - before.nblks);
 		}
-		sesunlock(blklist, ElvFalse);
+		blks[count] = blk->blklist.blk[i].blkno;
 	}
-	/*NOTREACHED*/
+	sesunlock(blklist, ElvFalse);
+	return count;
 }
 
 
@@ -1081,7 +1588,6 @@ register CHAR	*newp;	/* new text to be inserted */
 	BLK	*cblk;
 	int	nlines;
 register BLKNO	newblkno;	/* a new block */
-	BLKNO	blklist;
 	BLK	*newblk;
 	long	totlines = 0;
 register int	i;
@@ -1130,7 +1636,8 @@ register int	i;
 		/* if we're splitting an existing block... */
 		if (blkno != 0 && left != 0 && right != 0)
 		{
-			/* allocate a new block */
+			/* allocate a new block, near the one being split */
+			sesnear(blkno);
 			newblkno = seslock(sesalloc(0, SES_CHARS), ElvTrue, SES_CHARS);
 			newblk = sesblk(newblkno);
 
@@ -1151,8 +1658,7 @@ register int	i;
 			/* insert the new block after the first */
 			seslock(dst, ElvTrue, SES_BUFINFO);
 			biblk = sesblk(dst);
-			blklist = insblock(biblk->bufinfo.first, (LBLKNO)(lblkno + 1), newblkno, (COUNT)i, (COUNT)nlines);
-			biblk->bufinfo.first = blklist;
+			insroot(biblk, (LBLKNO)(lblkno + 1), newblkno, (COUNT)i, (COUNT)nlines);
 			biblk->bufinfo.changes++;
 			biblk->bufinfo.prevloc = dsttop;
 			biblk->bufinfo.checksum = checksum(biblk);
@@ -1185,11 +1691,14 @@ register int	i;
 		/* while we have more text to insert */
 		seslock(dst, ElvTrue, SES_BUFINFO);
 		biblk = sesblk(dst);
-		blklist = biblk->bufinfo.first;
 		while (newlen > 0)
 		{
-			/* allocate a new block */
-			newblkno = seslock(sesalloc(0, SES_CHARS), ElvTrue, SES_CHARS);
+			/* allocate a new block.  Try to put it right after the
+			 * previous block, so the text is contiguous in the file.
+			 */
+			if (blkno != 0)
+				sesnear(blkno);
+			blkno = newblkno = seslock(sesalloc(0, SES_CHARS), ElvTrue, SES_CHARS);
 			newblk = sesblk(newblkno);
 
 			/* copy text into it */
@@ -1206,11 +1715,10 @@ register int	i;
 			sesunlock(newblkno, ElvTrue);
 
 			/* insert the new block */
-			blklist = insblock(blklist, lblkno, newblkno, (COUNT)i, nlines);
+			insroot(biblk, lblkno, newblkno, (COUNT)i, (COUNT)nlines);
 			lblkno++;
 		}
 		biblk->bufinfo.changes++;
-		biblk->bufinfo.first = blklist;
 		biblk->bufinfo.checksum = checksum(biblk);
 		sesunlock(dst, ElvTrue);
 	}
@@ -1220,6 +1728,134 @@ register int	i;
 	return totlines;
 }
 
+/* This function loads text into an empty buffer.  The text is read by the
+ * "reader" function, which works like ioread(), directly into new CHARS
+ * blocks, and each block is filled to "blkfill" characters before it is
+ * appended to the buffer.  This is much faster than inserting the text a
+ * little at a time.  The number of characters loaded is stored in *nchars,
+ * and the number of newlines is returned.
+ */
+long lowload(dst, reader, nchars)
+	_BLKNO_	dst;	/* BUFINFO of an empty lowbuf */
+	int	(*reader) P_((CHAR *buf, int len)); /* function for reading text */
+	long	*nchars;/* output: number of characters loaded */
+{
+	BLK	*biblk;
+	BLKNO	newblkno;
+	BLK	*newblk;
+	LBLKNO	lblkno;
+	long	totlines = 0L;
+	int	i, n, nlines;
+	register CHAR	*scan;
+
+	safeinspect();
+#if LINECACHE
+	clobbercache(dst);
+#endif
+
+	(void)seslock(dst, ElvTrue, SES_BUFINFO);
+	biblk = sesblk(dst);
+	assert(biblk->bufinfo.first == 0);
+	*nchars = 0L;
+	for (lblkno = 0, newblkno = 0; ; lblkno++)
+	{
+		/* allocate a new block, right after the previous one */
+		if (newblkno != 0)
+			sesnear(newblkno);
+		newblkno = seslock(sesalloc(0, SES_CHARS), ElvTrue, SES_CHARS);
+		newblk = sesblk(newblkno);
+
+		/* fill it, counting newlines as we go */
+		nlines = 0;
+		for (i = 0; i < o_blkfill; i += n)
+		{
+			n = (*reader)(&newblk->chars.chars[i], (int)o_blkfill - i);
+			if (n <= 0)
+				break;
+			for (scan = &newblk->chars.chars[i]; scan < &newblk->chars.chars[i + n]; scan++)
+				if (*scan == '\n')
+					nlines++;
+		}
+		sesunlock(newblkno, ElvTrue);
+
+		/* if nothing was read, then we're done */
+		if (i == 0)
+		{
+			sesfree(newblkno);
+			break;
+		}
+
+		/* append it to the buffer */
+		insroot(biblk, lblkno, newblkno, (COUNT)i, (COUNT)nlines);
+		*nchars += i;
+		totlines += nlines;
+		if (n <= 0)
+			break;
+	}
+	if (*nchars > 0L)
+		biblk->bufinfo.changes++;
+	biblk->bufinfo.checksum = checksum(biblk);
+	sesunlock(dst, ElvTrue);
+
+	safeinspect();
+
+	return totlines;
+}
+
+#ifdef FEATURE_LAZYLOAD
+/* This function loads a large file into an empty buffer lazily.  The file's
+ * text isn't copied into the session file; each CHARS block is read from the
+ * file when it is needed.  The blocks are still read once here, to count
+ * their newlines, but that doesn't copy them into the session file.  Returns
+ * the number of newlines, and stores the number of characters in *nchars;
+ * or returns -1 if the file can't be loaded lazily.
+ */
+long lowlazy(dst, filename, minsize, nchars)
+	_BLKNO_	dst;		/* BUFINFO of an empty lowbuf */
+	char	*filename;	/* name of the file to load */
+	long	minsize;	/* smallest file to load lazily */
+	long	*nchars;	/* output: number of characters loaded */
+{
+	BLK	*biblk;
+	BLKNO	first;
+	int	i, n, nblks, nlines;
+	long	totlines = 0L;
+	register CHAR	*scan, *end;
+
+	/* allocate the blocks */
+	first = seslazy(filename, minsize, &nblks, nchars);
+	if (!first)
+		return -1L;
+
+#if LINECACHE
+	clobbercache(dst);
+#endif
+
+	/* count the newlines in each block, and add it to the buffer */
+	(void)seslock(dst, ElvTrue, SES_BUFINFO);
+	biblk = sesblk(dst);
+	assert(biblk->bufinfo.first == 0);
+	for (i = 0; i < nblks; i++)
+	{
+		n = (i < nblks - 1) ? o_blkfill : (int)(*nchars - (long)i * o_blkfill);
+		(void)seslock(first + i, ElvFalse, SES_CHARS);
+		scan = sesblk(first + i)->chars.chars;
+		for (nlines = 0, end = scan + n; scan < end; scan++)
+			if (*scan == '\n')
+				nlines++;
+		sesunlock(first + i, ElvFalse);
+		insroot(biblk, (LBLKNO)i, first + i, (COUNT)n, (COUNT)nlines);
+		totlines += nlines;
+	}
+	biblk->bufinfo.lazy = 1L;
+	biblk->bufinfo.changes++;
+	biblk->bufinfo.checksum = checksum(biblk);
+	sesunlock(dst, ElvTrue);
+
+	return totlines;
+}
+#endif /* FEATURE_LAZYLOAD */
+
 /* This function deletes characters located between two points.  It returns
  * the change in the number of lines (i.e., the negative of the quantity of
  * newlines deleted).
@@ -1245,6 +1881,7 @@ long lowdelete(dst, dsttop, dstbottom)
 	COUNT	lastright;	/* chars in firstlblk to right of dstbottom */
 	LBLKNO	lblkno;
 	BLK	*biblk;
+	struct blki_s deleted;	/* info about a deleted block */
 	int	i, j;
 
 	safeinspect();
@@ -1276,7 +1913,8 @@ long lowdelete(dst, dsttop, dstbottom)
 		if (firstleft == 0 && lastleft == firstright)
 		{
 			/* yes, delete the whole block */
-			biblk->bufinfo.first = delblock(biblk->bufinfo.first, firstlblk, (LBLKNO *)0, &nlines);
+			delroot(biblk, firstlblk, &deleted);
+			nlines = deleted.nlines;
 			safeinspect();
 		}
 		else
@@ -1321,8 +1959,8 @@ long lowdelete(dst, dsttop, dstbottom)
 		     lblkno + 1 < (lastright == 0 ? lastlblk + 1 : lastlblk);
 		     lastlblk--)
 		{
-			biblk->bufinfo.first = delblock(biblk->bufinfo.first, lblkno, (LBLKNO *)0, &nlines);
-			totlines -= (long)nlines;
+			delroot(biblk, lblkno, &deleted);
+			totlines -= (long)deleted.nlines;
 		}
 		lastlblk--;
 		safeinspect();
@@ -1390,8 +2028,16 @@ long lowdelete(dst, dsttop, dstbottom)
 	biblk->bufinfo.prevloc = dsttop;
 	biblk->bufinfo.checksum = checksum(biblk);
 
-	/* Unlock the bufinfo block for writing */
+	/* Unlock the bufinfo block for writing.  If the tree got shorter, then
+	 * flush the bufinfo block before freeing the old root blocks.
+	 */
 	sesunlock(dst, ElvTrue);
+	if (noldroots > 0)
+	{
+		sesflush(dst);
+		while (noldroots > 0)
+			sesfree(oldroot[--noldroots]);
+	}
 	safeinspect();
 	return totlines;
 }
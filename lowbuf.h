@@ -11,8 +11,13 @@ extern void	lowfree P_((_BLKNO_ bufinfo));
 extern void	lowtitle P_((_BLKNO_ bufinfo, CHAR *title));
 extern long	lowline P_((_BLKNO_ bufinfo, long lineno));
 extern BLKNO	lowoffset P_((_BLKNO_ bufinfo, long offset, COUNT *left, COUNT *right, LBLKNO *lptr, long *linenum));
+extern int	lowahead P_((_BLKNO_ bufinfo, long offset, ELVBOOL forward, BLKNO *blks, int max));
 extern long	lowdelete P_((_BLKNO_ dst, long dsttop, long dstbottom));
 extern long	lowinsert P_((_BLKNO_ dst, long dsttop, CHAR *newp, long newlen));
+extern long	lowload P_((_BLKNO_ dst, int (*reader)(CHAR *buf, int len), long *nchars));
+#ifdef FEATURE_LAZYLOAD
+extern long	lowlazy P_((_BLKNO_ dst, char *filename, long minsize, long *nchars));
+#endif
 extern long	lowreplace P_((_BLKNO_ dst, long dsttop, long dstbottom, CHAR *newp, long newlen));
 extern long	lowpaste P_((_BLKNO_ dst, long dsttop, _BLKNO_ src, long srctop, long srcbottom));
 extern void	lowflush P_((_BLKNO_ bufinfo));
@@ -20,7 +20,19 @@ extern ELVBOOL	blkopen P_((ELVBOOL force, BLK *buf));
 extern void	blkclose P_((BLK *buf));
 extern void	blkwrite P_((BLK *buf, _BLKNO_ blkno));
 extern void	blkread P_((BLK *buf, _BLKNO_ blkno));
+extern void	blkextend P_((_BLKNO_ from, _BLKNO_ to));
+extern void	blkahead P_((_BLKNO_ blkno, int n));
 extern void	blksync P_((void));
+#ifdef FEATURE_MMAP
+extern BLK	*blkptr P_((_BLKNO_ blkno));
+#endif
+#ifdef FEATURE_LAZYLOAD
+extern int	blkbackopen P_((char *filename, long *size));
+extern ELVBOOL	blkbackread P_((int handle, BLK *buf, long offset, int len));
+extern ELVBOOL	blkbacksame P_((int handle, char *filename));
+extern void	blkbackahead P_((int handle, long offset, long len));
+extern void	blkbackclose P_((int handle));
+#endif
 
 extern char	*dirfirst P_((char *wildexpr, ELVBOOL ispartial));
 extern char	*dirnext P_((void));
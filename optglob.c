@@ -21,11 +21,13 @@ static OPTDESC ogdesc[] =
 	{"blksize", "bsz",	optnstring,	optisnumber,	"256:8192" },
 	{"blkhash", "hash",	optnstring,	optisnumber,	"1:500" },
 	{"blkcache", "cache",	optnstring,	optisnumber,	"5:200" },
+	{"blkcachemb", "cachemb", optnstring,	optisnumber,	"0:4096" },
 	{"blkgrow", "bgr",	optnstring,	optisnumber,	"1:32" },
 	{"blkfill", "bfill",	optnstring,	optisnumber	},
 	{"blkhit", "bh",	optnstring,	optisnumber	},
 	{"blkmiss", "bm",	optnstring,	optisnumber	},
 	{"blkwrite", "bw",	optnstring,	optisnumber	},
+	{"blkevict", "bev",	optnstring,	optisnumber	},
 	{"version", "ver",	optsstring,	optisstring	},
 	{"bitsperchar", "bits",	optnstring,	optisnumber	},
 	{"gui", "gui",		optsstring,	optisstring	},
@@ -135,6 +137,9 @@ static OPTDESC ogdesc[] =
 	{"persist", "pers",	optsstring,	bufpersispacked,"cursor,change,hours:,marks,regions,folds,external:,ex:,search:,args:,max:"},
 	{"persistonce","pero",	optsstring,	optispacked,	"cursor,change,hours:,marks,regions,folds,external:,ex:,search:,args:,max:"},
 	{"facesused","faces",	optnstring,	optisnumber,	},
+	{"syncdelay", "sdl",	optnstring,	optisnumber,	"0:60000"},
+	{"lazyload", "lazy",	optnstring,	optisnumber,	"0:1000000"},
+	{"blkahead", "bah",	optnstring,	optisnumber,	"0:256"},
 
 	/* added these for the sake of backward compatibility : */
 	{"more", "mo",		NULL,		NULL		},
@@ -226,11 +231,13 @@ void optglobinit()
 	optpreset(o_blksize, BLKSIZE, OPT_LOCK|OPT_HIDE);
 	optpreset(o_blkhash, BLKHASH, OPT_HIDE);
 	optpreset(o_blkcache, BLKCACHE, OPT_HIDE);
+	optpreset(o_blkcachemb, BLKCACHEMB, OPT_HIDE);
 	optpreset(o_blkgrow, BLKGROW, OPT_HIDE);
 	optflags(o_blkfill) = OPT_LOCK|OPT_HIDE;
 	optflags(o_blkhit) = OPT_LOCK|OPT_HIDE;
 	optflags(o_blkmiss) = OPT_LOCK|OPT_HIDE;
 	optflags(o_blkwrite) = OPT_LOCK|OPT_HIDE;
+	optflags(o_blkevict) = OPT_LOCK|OPT_HIDE;
 	optpreset(o_version, toCHAR(VERSION), OPT_LOCK|OPT_HIDE);
 	optpreset(o_bitsperchar, 8 * sizeof(CHAR), OPT_LOCK|OPT_HIDE);
 	optpreset(o_os, toCHAR(OSNAME), OPT_LOCK|OPT_HIDE);
@@ -292,6 +299,9 @@ void optglobinit()
 	optpreset(o_nonascii, 'm', OPT_HIDE); /* most */
 	optflags(o_digraph) = OPT_HIDE;
 	optpreset(o_sync, ElvFalse, OPT_HIDE);
+	optpreset(o_syncdelay, 0, OPT_HIDE);
+	optpreset(o_lazyload, 64, OPT_HIDE);
+	optpreset(o_blkahead, 64, OPT_HIDE);
 	optflags(o_autoselect) = OPT_HIDE;
 	optflags(o_defaultreadonly) = OPT_HIDE;
 	optflags(o_exrefresh) = OPT_HIDE;
@@ -12,126 +12,131 @@ extern OPTVAL lpval[];
 #define o_blksize		optglob[0].value.number
 #define o_blkhash		optglob[1].value.number
 #define o_blkcache		optglob[2].value.number
-#define o_blkgrow		optglob[3].value.number
-#define o_blkfill		optglob[4].value.number
-#define o_blkhit		optglob[5].value.number
-#define o_blkmiss		optglob[6].value.number
-#define o_blkwrite		optglob[7].value.number
-#define o_version		optglob[8].value.string
-#define o_bitsperchar		optglob[9].value.number
-#define o_gui			optglob[10].value.string
-#define o_os			optglob[11].value.string
-#define o_session		optglob[12].value.string
-#define o_recovering		optglob[13].value.boolean
-#define o_digraph		optglob[14].value.boolean
-#define o_exrc			optglob[15].value.boolean
-#define o_modeline		optglob[16].value.boolean
-#define o_modelines		optglob[17].value.number
-#define o_ignorecase		optglob[18].value.boolean
-#define o_magic			optglob[19].value.boolean
-#define o_magicchar		optglob[20].value.string
-#define o_magicname		optglob[21].value.boolean
-#define o_magicperl		optglob[22].value.boolean
-#define o_novice		optglob[23].value.boolean
-#define o_prompt		optglob[24].value.boolean
-#define o_remap			optglob[25].value.boolean
-#define o_report		optglob[26].value.number
-#define o_shell			optglob[27].value.string
-#define o_sync			optglob[28].value.boolean
-#define o_taglength		optglob[29].value.number
-#define o_tagkind		optglob[30].value.boolean
-#define o_taglibrary		optglob[31].value.boolean
-#define o_tags			optglob[32].value.string
-#define o_tagstack		optglob[33].value.boolean
-#define o_tagprg		optglob[34].value.string
-#define o_autoprint		optglob[35].value.boolean
-#define o_autowrite		optglob[36].value.boolean
-#define o_autoselect		optglob[37].value.boolean
-#define o_warn			optglob[38].value.boolean
-#define o_window		optglob[39].value.number
-#define o_wrapscan		optglob[40].value.boolean
-#define o_writeany		optglob[41].value.boolean
-#define o_defaultreadonly	optglob[42].value.boolean
-#define o_initialstate		optglob[43].value.character
-#define o_exitcode		optglob[44].value.number
-#define o_keytime		optglob[45].value.number
-#define o_usertime		optglob[46].value.number
-#define o_security		optglob[47].value.character
-#define o_tempsession		optglob[48].value.boolean
-#define o_newsession		optglob[49].value.boolean
-#define o_exrefresh		optglob[50].value.boolean
-#define o_home			optglob[51].value.string
-#define o_elvispath		optglob[52].value.string
-#define o_terse			optglob[53].value.boolean
-#define o_previousdir		optglob[54].value.string
-#define o_previousfile		optglob[55].value.string
-#define o_previousfileline	optglob[56].value.number
-#define o_previouscommand	optglob[57].value.string
-#define o_previoustag		optglob[58].value.string
-#define o_nearscroll		optglob[59].value.number
-#define o_optimize		optglob[60].value.boolean
-#define o_edcompatible		optglob[61].value.boolean
-#define o_pollfrequency		optglob[62].value.number
-#define o_sentenceend		optglob[63].value.string
-#define o_sentencequote		optglob[64].value.string
-#define o_sentencegap		optglob[65].value.number
-#define o_verbose		optglob[66].value.number
-#define o_anyerror		optglob[67].value.boolean
-#define o_directory		optglob[68].value.string
-#define o_errorbells		optglob[69].value.boolean
-#define o_warningbells		optglob[70].value.boolean
-#define o_flash			optglob[71].value.boolean
-#define o_program		optglob[72].value.string
-#define o_backup		optglob[73].value.boolean
-#define o_showmarkups		optglob[74].value.boolean
-#define o_nonascii		optglob[75].value.character
-#define o_beautify		optglob[76].value.boolean
-#define o_mesg			optglob[77].value.boolean
-#define o_sessionpath		optglob[78].value.string
-#define o_maptrace		optglob[79].value.character
-#define o_maplog		optglob[80].value.character
-#define o_gdefault		optglob[81].value.boolean
-#define o_matchchar		optglob[82].value.string
-#define o_show			optglob[83].value.string
-#define o_writeenc		optglob[84].value.character
-#define o_writeeol		optglob[85].value.character
-#define o_binary		optglob[86].value.boolean
-#define o_saveregexp		optglob[87].value.boolean
-#define o_true			optglob[88].value.string
-#define o_false			optglob[89].value.string
-#define o_animation		optglob[90].value.number
-#define o_completebinary	optglob[91].value.boolean
-#define o_optionwidth		optglob[92].value.number
-#define o_smarttab		optglob[93].value.boolean
-#define o_smartcase		optglob[94].value.boolean
-#define o_hlsearch		optglob[95].value.boolean
-#define o_background		optglob[96].value.character
-#define o_incsearch		optglob[97].value.boolean
-#define o_spelldict		optglob[98].value.string
-#define o_spellautoload		optglob[99].value.boolean
-#define o_spellsuffix		optglob[100].value.string
-#define o_locale		optglob[101].value.string
-#define o_mkexrcfile		optglob[102].value.string
-#define o_prefersyntax		optglob[103].value.character
-#define o_eventignore		optglob[104].value.string
-#define o_eventerrors		optglob[105].value.boolean
-#define o_tweaksection		optglob[106].value.boolean
-#define o_timeout 		optglob[107].value.boolean
-#define o_listchars		optglob[108].value.string
-#define o_cleantext		optglob[109].value.string
-#define o_filenamerules		optglob[110].value.string
-#define o_state			optglob[111].value.string
-#define o_initializing		optglob[112].value.boolean
-#define o_persistfile		optglob[113].value.string
-#define o_persist		optglob[114].value.string
-#define o_persistonce		optglob[115].value.string
-#define o_facesused		optglob[116].value.number
+#define o_blkcachemb		optglob[3].value.number
+#define o_blkgrow		optglob[4].value.number
+#define o_blkfill		optglob[5].value.number
+#define o_blkhit		optglob[6].value.number
+#define o_blkmiss		optglob[7].value.number
+#define o_blkwrite		optglob[8].value.number
+#define o_blkevict		optglob[9].value.number
+#define o_version		optglob[10].value.string
+#define o_bitsperchar		optglob[11].value.number
+#define o_gui			optglob[12].value.string
+#define o_os			optglob[13].value.string
+#define o_session		optglob[14].value.string
+#define o_recovering		optglob[15].value.boolean
+#define o_digraph		optglob[16].value.boolean
+#define o_exrc			optglob[17].value.boolean
+#define o_modeline		optglob[18].value.boolean
+#define o_modelines		optglob[19].value.number
+#define o_ignorecase		optglob[20].value.boolean
+#define o_magic			optglob[21].value.boolean
+#define o_magicchar		optglob[22].value.string
+#define o_magicname		optglob[23].value.boolean
+#define o_magicperl		optglob[24].value.boolean
+#define o_novice		optglob[25].value.boolean
+#define o_prompt		optglob[26].value.boolean
+#define o_remap			optglob[27].value.boolean
+#define o_report		optglob[28].value.number
+#define o_shell			optglob[29].value.string
+#define o_sync			optglob[30].value.boolean
+#define o_taglength		optglob[31].value.number
+#define o_tagkind		optglob[32].value.boolean
+#define o_taglibrary		optglob[33].value.boolean
+#define o_tags			optglob[34].value.string
+#define o_tagstack		optglob[35].value.boolean
+#define o_tagprg		optglob[36].value.string
+#define o_autoprint		optglob[37].value.boolean
+#define o_autowrite		optglob[38].value.boolean
+#define o_autoselect		optglob[39].value.boolean
+#define o_warn			optglob[40].value.boolean
+#define o_window		optglob[41].value.number
+#define o_wrapscan		optglob[42].value.boolean
+#define o_writeany		optglob[43].value.boolean
+#define o_defaultreadonly	optglob[44].value.boolean
+#define o_initialstate		optglob[45].value.character
+#define o_exitcode		optglob[46].value.number
+#define o_keytime		optglob[47].value.number
+#define o_usertime		optglob[48].value.number
+#define o_security		optglob[49].value.character
+#define o_tempsession		optglob[50].value.boolean
+#define o_newsession		optglob[51].value.boolean
+#define o_exrefresh		optglob[52].value.boolean
+#define o_home			optglob[53].value.string
+#define o_elvispath		optglob[54].value.string
+#define o_terse			optglob[55].value.boolean
+#define o_previousdir		optglob[56].value.string
+#define o_previousfile		optglob[57].value.string
+#define o_previousfileline	optglob[58].value.number
+#define o_previouscommand	optglob[59].value.string
+#define o_previoustag		optglob[60].value.string
+#define o_nearscroll		optglob[61].value.number
+#define o_optimize		optglob[62].value.boolean
+#define o_edcompatible		optglob[63].value.boolean
+#define o_pollfrequency		optglob[64].value.number
+#define o_sentenceend		optglob[65].value.string
+#define o_sentencequote		optglob[66].value.string
+#define o_sentencegap		optglob[67].value.number
+#define o_verbose		optglob[68].value.number
+#define o_anyerror		optglob[69].value.boolean
+#define o_directory		optglob[70].value.string
+#define o_errorbells		optglob[71].value.boolean
+#define o_warningbells		optglob[72].value.boolean
+#define o_flash			optglob[73].value.boolean
+#define o_program		optglob[74].value.string
+#define o_backup		optglob[75].value.boolean
+#define o_showmarkups		optglob[76].value.boolean
+#define o_nonascii		optglob[77].value.character
+#define o_beautify		optglob[78].value.boolean
+#define o_mesg			optglob[79].value.boolean
+#define o_sessionpath		optglob[80].value.string
+#define o_maptrace		optglob[81].value.character
+#define o_maplog		optglob[82].value.character
+#define o_gdefault		optglob[83].value.boolean
+#define o_matchchar		optglob[84].value.string
+#define o_show			optglob[85].value.string
+#define o_writeenc		optglob[86].value.character
+#define o_writeeol		optglob[87].value.character
+#define o_binary		optglob[88].value.boolean
+#define o_saveregexp		optglob[89].value.boolean
+#define o_true			optglob[90].value.string
+#define o_false			optglob[91].value.string
+#define o_animation		optglob[92].value.number
+#define o_completebinary	optglob[93].value.boolean
+#define o_optionwidth		optglob[94].value.number
+#define o_smarttab		optglob[95].value.boolean
+#define o_smartcase		optglob[96].value.boolean
+#define o_hlsearch		optglob[97].value.boolean
+#define o_background		optglob[98].value.character
+#define o_incsearch		optglob[99].value.boolean
+#define o_spelldict		optglob[100].value.string
+#define o_spellautoload		optglob[101].value.boolean
+#define o_spellsuffix		optglob[102].value.string
+#define o_locale		optglob[103].value.string
+#define o_mkexrcfile		optglob[104].value.string
+#define o_prefersyntax		optglob[105].value.character
+#define o_eventignore		optglob[106].value.string
+#define o_eventerrors		optglob[107].value.boolean
+#define o_tweaksection		optglob[108].value.boolean
+#define o_timeout 		optglob[109].value.boolean
+#define o_listchars		optglob[110].value.string
+#define o_cleantext		optglob[111].value.string
+#define o_filenamerules		optglob[112].value.string
+#define o_state			optglob[113].value.string
+#define o_initializing		optglob[114].value.boolean
+#define o_persistfile		optglob[115].value.string
+#define o_persist		optglob[116].value.string
+#define o_persistonce		optglob[117].value.string
+#define o_facesused		optglob[118].value.number
+#define o_syncdelay		optglob[119].value.number
+#define o_lazyload		optglob[120].value.number
+#define o_blkahead		optglob[121].value.number
 
 /* For backward compatibility with older releases of elvis : */
-#define o_more    		optglob[117].value.boolean
-#define o_hardtabs		optglob[118].value.number
-#define o_redraw		optglob[119].value.boolean
-#define QTY_GLOBAL_OPTS			120
+#define o_more    		optglob[122].value.boolean
+#define o_hardtabs		optglob[123].value.number
+#define o_redraw		optglob[124].value.boolean
+#define QTY_GLOBAL_OPTS			125
 
 #ifdef FEATURE_LPR
 # define o_lptype		lpval[0].value.string
@@ -292,6 +292,24 @@ void blkread(BLK *buf, _BLKNO_ blkno)
 	}
 }
 
+/* Make sure blocks "from" up to (but not including) "to" exist and contain
+ * zeroes.  This is called whenever the session file must grow.
+ */
+void blkextend(_BLKNO_ from, _BLKNO_ to)
+{
+	BLK	*tmp;
+
+	tmp = (BLK *)safealloc((int)o_blksize, sizeof(char));
+	for (; from < to; from++)
+		blkwrite(tmp, from);
+	safefree(tmp);
+}
+
+/* Give a hint that some blocks will be read soon.  Ignored here. */
+void blkahead(_BLKNO_ blkno, int n)
+{
+}
+
 /* Force changes out to disk. */
 void blksync P_((void))
 {
@@ -43,6 +43,7 @@
 #undef	FEATURE_PROTO	/* using aliases to add new protocols */
 #undef	FEATURE_RAM	/* if invoked with "-f ram" then use XMS/EMS */
 #undef	FEATURE_RCSID	/* include RCS Id strings for all source files */
+#undef	FEATURE_REGDFA	/* faster searches for complex regexps */
 #undef	FEATURE_REGION	/* the :region command */
 #undef	FEATURE_SHOWTAG	/* the "showtag" option */
 #undef	FEATURE_SMARTARGS /* show arguments when inputting a function call */
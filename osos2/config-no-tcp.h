@@ -60,6 +60,7 @@
 #define	FEATURE_PROTO	/* using aliases to add new protocols */
 #define	FEATURE_RAM     /* using ram instead of disk for session files */
 #undef	FEATURE_RCSID	/* include RCS Id strings for all source files */
+#define	FEATURE_REGDFA	/* faster searches for complex regexps */
 #define	FEATURE_REGION	/* the :region command */
 #define	FEATURE_SHOWTAG	/* the showtag option */
 #define	FEATURE_SMARTARGS /* show arguments when inputting a function call */
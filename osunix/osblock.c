@@ -2,6 +2,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -9,6 +10,12 @@
 # define S_ISDIR(mode)	((mode & 0170000) == 0040000)
 #endif
 #include "elvis.h"
+#ifdef FEATURE_MMAP
+# include <sys/mman.h>
+# ifndef MAP_FAILED
+#  define MAP_FAILED	((void *)-1)
+# endif
+#endif
 #ifdef FEATURE_RCSID
 char id_osblock[] = "$Id: osblock.c,v 2.30 2003/10/17 17:41:23 steve Exp $";
 #endif
@@ -31,10 +38,218 @@ char id_osblock[] = "$Id: osblock.c,v 2.30 2003/10/17 17:41:23 steve Exp $";
 
 
 static int fd = -1; /* file descriptor of the session file */
+static ELVBOOL syncpending;	/* has a blksync() been deferred? */
+static struct timeval lastsync;	/* time when session was last forced out */
+
+#if USE_PROTOTYPES
+static void flushsession(void);
+#endif
 #ifdef FEATURE_RAM
 static BLK **blklist;
 static int nblks;
 #endif
+#ifdef FEATURE_MMAP
+static ELVBOOL	mapped;		/* is the session file mapped into memory? */
+static char	**extent;	/* addresses of mapped extents, or NULL */
+static int	nextents;	/* size of the extent[] array */
+static long	extblks;	/* number of blocks per extent */
+static off_t	mapsize;	/* current size of the session file */
+
+/* Return a pointer to a block within the mapped session file.  The file is
+ * mapped in fixed-size extents which are never unmapped until the session
+ * is closed, so the returned pointer remains valid even after the file grows.
+ * Each extent holds one page's worth of blocks, so extents always start on a
+ * page boundary regardless of the block size.
+ */
+static BLK *mapblk(blkno)
+	_BLKNO_	blkno;	/* block whose address is desired */
+{
+	int	i;
+	off_t	offset, end;
+	size_t	len;
+	char	*addr;
+
+	/* choose an extent size */
+	if (extblks == 0)
+	{
+		extblks = sysconf(_SC_PAGESIZE);
+		if (extblks <= 0)
+			extblks = 4096;
+	}
+	len = (size_t)extblks * (size_t)o_blksize;
+
+	/* make sure the extent[] array is big enough */
+	i = (int)(blkno / extblks);
+	if (i >= nextents)
+	{
+		extent = (char **)realloc(extent, (i + 16) * sizeof(char *));
+		if (!extent)
+			msg(MSG_FATAL, "no memory for session extents");
+		memset(&extent[nextents], 0, (i + 16 - nextents) * sizeof(char *));
+		nextents = i + 16;
+	}
+
+	/* if the extent isn't mapped yet, then map it now */
+	if (!extent[i])
+	{
+		/* extend the file, so the whole extent is backed by storage */
+		offset = (off_t)i * (off_t)len;
+		end = offset + (off_t)len;
+		if (end > mapsize)
+		{
+			if (ftruncate(fd, end) != 0)
+				msg(MSG_FATAL, "can't grow the session file");
+			mapsize = end;
+		}
+
+		addr = (char *)mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, offset);
+		if (addr == (char *)MAP_FAILED)
+			msg(MSG_FATAL, "[d]can't map session block $1", (int)blkno);
+		extent[i] = addr;
+	}
+
+	return (BLK *)(extent[i] + (size_t)(blkno % extblks) * (size_t)o_blksize);
+}
+
+/* Return a pointer to the block in the mapped session file, or NULL if the
+ * session file isn't mapped.  The session cache uses this to avoid copying
+ * blocks in and out of its own buffers.
+ */
+BLK *blkptr(blkno)
+	_BLKNO_	blkno;	/* block whose address is desired */
+{
+	if (!mapped)
+		return NULL;
+	return mapblk(blkno);
+}
+#endif
+
+#ifdef FEATURE_LAZYLOAD
+/* These describe the files which lazily loaded buffers read their text from.
+ * Each file is kept open, so its text remains available even if the file is
+ * renamed or removed.  Its size and modification time are remembered, so
+ * that changes made by other programs can be detected.
+ */
+static struct backfile_s
+{
+	int	fd;	/* descriptor of the file, or -1 if slot is unused */
+	off_t	size;	/* size of the file when it was opened */
+	time_t	mtime;	/* modification time when it was opened */
+	int	reads;	/* number of reads since the file was last checked */
+} *backfile;
+static int nbackfiles;
+
+/* Open a file so that blocks of its text can be read on demand.  Stores the
+ * file's size in *size, and returns a handle for the file, or -1 if it
+ * can't be used that way.
+ */
+int blkbackopen(filename, size)
+	char	*filename;	/* name of a local file */
+	long	*size;		/* output: size of the file */
+{
+	struct stat st;
+	int	fd, i;
+
+	/* it must be a normal file, and its size must fit in a long */
+	fd = open(filename, O_RDONLY|O_BINARY);
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (off_t)(long)st.st_size != st.st_size)
+	{
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	/* find an unused slot, or add one */
+	for (i = 0; i < nbackfiles && backfile[i].fd >= 0; i++)
+	{
+	}
+	if (i >= nbackfiles)
+	{
+		backfile = (struct backfile_s *)realloc(backfile, (nbackfiles + 4) * sizeof *backfile);
+		if (!backfile)
+			msg(MSG_FATAL, "no memory for lazy loading");
+		for (nbackfiles += 4; i < nbackfiles; i++)
+			backfile[i].fd = -1;
+		i = nbackfiles - 4;
+	}
+
+	backfile[i].fd = fd;
+	backfile[i].size = st.st_size;
+	backfile[i].mtime = st.st_mtime;
+	backfile[i].reads = 0;
+	*size = (long)st.st_size;
+	return i;
+}
+
+/* Read part of a file opened via blkbackopen().  If fewer than "len" bytes
+ * can be read, the rest of buf is zeroed.  Returns ElvFalse if the file has
+ * been changed since it was opened.  The file is checked when a read comes
+ * up short, and every so often otherwise.
+ */
+ELVBOOL blkbackread(handle, buf, offset, len)
+	int	handle;	/* value returned by blkbackopen() */
+	BLK	*buf;	/* where to store the bytes */
+	long	offset;	/* offset of the first byte to read */
+	int	len;	/* number of bytes to read */
+{
+	struct backfile_s *bf = &backfile[handle];
+	struct stat st;
+	ssize_t	got;
+
+	assert(handle >= 0 && handle < nbackfiles && bf->fd >= 0);
+	got = pread(bf->fd, (char *)buf, (size_t)len, (off_t)offset);
+	if (got < 0)
+		got = 0;
+	memset((char *)buf + got, 0, (size_t)o_blksize - got);
+	if (got < len || ++bf->reads >= 256)
+	{
+		bf->reads = 0;
+		if (fstat(bf->fd, &st) != 0
+		 || st.st_size != bf->size
+		 || st.st_mtime != bf->mtime)
+			return ElvFalse;
+	}
+	return ElvTrue;
+}
+
+/* Return ElvTrue if "filename" is the file opened as "handle" */
+ELVBOOL blkbacksame(handle, filename)
+	int	handle;		/* value returned by blkbackopen() */
+	char	*filename;	/* name of some file */
+{
+	struct stat st, bst;
+
+	return (ELVBOOL)(stat(filename, &st) == 0
+		&& fstat(backfile[handle].fd, &bst) == 0
+		&& st.st_dev == bst.st_dev
+		&& st.st_ino == bst.st_ino);
+}
+
+/* Give the OS a hint that part of a file opened via blkbackopen() will be
+ * read soon.
+ */
+void blkbackahead(handle, offset, len)
+	int	handle;	/* value returned by blkbackopen() */
+	long	offset;	/* offset of the first byte to be read soon */
+	long	len;	/* number of bytes */
+{
+	assert(handle >= 0 && handle < nbackfiles && backfile[handle].fd >= 0);
+#ifdef POSIX_FADV_WILLNEED
+	(void)posix_fadvise(backfile[handle].fd, (off_t)offset, (off_t)len, POSIX_FADV_WILLNEED);
+#endif
+}
+
+/* Close a file opened via blkbackopen() */
+void blkbackclose(handle)
+	int	handle;	/* value returned by blkbackopen() */
+{
+	assert(handle >= 0 && handle < nbackfiles && backfile[handle].fd >= 0);
+	close(backfile[handle].fd);
+	backfile[handle].fd = -1;
+}
+#endif /* FEATURE_LAZYLOAD */
 
 /* This function creates a new block file, and returns ElvTrue if successful,
  * or ElvFalse if failed because the file was already busy.
@@ -59,6 +274,14 @@ ELVBOOL blkopen(force, buf)
 		return ElvTrue;
 	}
 #endif
+#ifdef FEATURE_MMAP
+	/* "-f mmap" uses a normal session file, but maps it into memory */
+	if (o_session && !CHARcmp(o_session, toCHAR("mmap")))
+	{
+		mapped = ElvTrue;
+		o_session = NULL;
+	}
+#endif
 
 	/* If no session file was explicitly requested, try successive
 	 * defaults until we find an existing file (if we're trying to
@@ -201,6 +424,12 @@ ELVBOOL blkopen(force, buf)
 	(void)write(fd, (char *)buf, sizeof buf->super);
 	/* lockf(fd, ULOCK, o_blksize); */
 
+#ifdef FEATURE_MMAP
+	/* remember the file's size, so we know when to grow it */
+	if (mapped)
+		mapsize = fstat(fd, &st) == 0 ? st.st_size : 0;
+#endif
+
 	/* done! */
 	return ElvTrue;
 }
@@ -212,9 +441,25 @@ void blkclose(buf)
 {
 	if (fd < 0)
 		return;
+#ifdef FEATURE_MMAP
+	/* unmap the file.  The superblock is then updated via normal I/O */
+	if (mapped)
+	{
+		while (--nextents >= 0)
+			if (extent[nextents])
+				munmap(extent[nextents], (size_t)extblks * (size_t)o_blksize);
+		free(extent);
+		extent = NULL;
+		nextents = 0;
+		mapped = ElvFalse;
+	}
+#endif
 	blkread(buf, 0);
 	buf->super.inuse = 0L;
 	blkwrite(buf, 0);
+	if (syncpending && !o_tempsession)
+		flushsession();
+	syncpending = ElvFalse;
 	close(fd);
 	fd = -1;
 	if (o_tempsession)
@@ -249,6 +494,16 @@ void blkwrite(buf, blkno)
 		return;
 	}
 #endif
+#ifdef FEATURE_MMAP
+	/* copy it into the mapped file, unless it is already there */
+	if (mapped)
+	{
+		BLK	*dest = mapblk(blkno);
+		if (dest != buf)
+			memcpy(dest, buf, o_blksize);
+		return;
+	}
+#endif
 
 	/* write the block */
 	lseek(fd, (off_t)blkno * (off_t)o_blksize, 0);
@@ -273,6 +528,15 @@ void blkread(buf, blkno)
 		return;
 	}
 #endif
+#ifdef FEATURE_MMAP
+	if (mapped)
+	{
+		BLK	*src = mapblk(blkno);
+		if (src != buf)
+			memcpy(buf, src, o_blksize);
+		return;
+	}
+#endif
 
 	/* read the block */
 	lseek(fd, (off_t)blkno * o_blksize, 0);
@@ -282,16 +546,179 @@ void blkread(buf, blkno)
 	}
 }
 
-/* Force changes out to disk.  Ideally we would only force the session file's
- * blocks out to the disk, but UNIX doesn't offer a way to do that, so we
- * force them all out.  Major bummer.
+/* Make sure blocks "from" up to (but not including) "to" exist and contain
+ * zeroes.  This is called whenever the session file must grow.  Where the
+ * file is simply extended, ftruncate() or posix_fallocate() is used instead
+ * of writing dummy blocks; only blocks that already exist in the file, left
+ * over from an earlier use of it, need to be zeroed explicitly.
+ */
+void blkextend(from, to)
+	_BLKNO_	from;	/* first block to preallocate */
+	_BLKNO_	to;	/* block after the last one to preallocate */
+{
+	struct stat st;
+	off_t	end;
+	BLK	*tmp;
+
+#ifdef FEATURE_RAM
+	if (nblks > 0)
+	{
+		if (to > nblks)
+		{
+			blklist = (BLK **)realloc(blklist, (to + 1024) * sizeof(BLK *));
+			memset(&blklist[nblks], 0, (to + 1024 - nblks) * sizeof(BLK *));
+			nblks = to + 1024;
+		}
+		for (; from < to; from++)
+		{
+			if (!blklist[from])
+				blklist[from] = (BLK *)malloc(o_blksize);
+			if (!blklist[from])
+				msg(MSG_FATAL, "blkextend failed");
+			memset(blklist[from], 0, o_blksize);
+		}
+		return;
+	}
+#endif
+
+	/* zero any stale blocks that already exist */
+	end = (off_t)to * (off_t)o_blksize;
+	if (fstat(fd, &st) != 0)
+		st.st_size = (off_t)from * (off_t)o_blksize;
+	if (st.st_size > (off_t)from * (off_t)o_blksize)
+	{
+		tmp = (BLK *)safealloc((int)o_blksize, sizeof(char));
+		for (; from < to && (off_t)from * (off_t)o_blksize < st.st_size; from++)
+			blkwrite(tmp, from);
+		safefree(tmp);
+	}
+	if (from >= to || st.st_size >= end)
+		return;
+
+	/* allocate the rest, if the OS supports it; else just grow the file.
+	 * Any gap before "from" is left as a hole, since it may be a run of
+	 * lazily loaded blocks which are never written.
+	 */
+	if (st.st_size < (off_t)from * (off_t)o_blksize)
+		st.st_size = (off_t)from * (off_t)o_blksize;
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+	if (posix_fallocate(fd, st.st_size, end - st.st_size) != 0)
+#endif
+	if (ftruncate(fd, end) != 0)
+		msg(MSG_FATAL, "can't grow the session file");
+#ifdef FEATURE_MMAP
+	if (mapped && end > mapsize)
+		mapsize = end;
+#endif
+}
+
+/* Give the OS a hint that blocks "blkno" through "blkno+n-1" will be read
+ * soon, so it can start reading them in the background.  This is only a
+ * hint; the blocks are still read normally via blkread() later.
+ */
+void blkahead(blkno, n)
+	_BLKNO_	blkno;	/* first block to be read soon */
+	int	n;	/* number of consecutive blocks */
+{
+#ifdef FEATURE_RAM
+	if (nblks > 0)
+		return;
+#endif
+#ifdef FEATURE_MMAP
+	if (mapped)
+	{
+# ifdef MADV_WILLNEED
+		int	i;
+		long	from, to;
+		size_t	start, end;
+
+		/* advise the part of each mapped extent which overlaps the
+		 * range.  Extents start on a page boundary, and extblks is
+		 * the page size, so rounding to extblks keeps it aligned.
+		 */
+		for (; n > 0; blkno += to - from, n -= (int)(to - from))
+		{
+			i = (int)(blkno / extblks);
+			from = blkno % extblks;
+			to = from + n;
+			if (to > extblks)
+				to = extblks;
+			if (i < nextents && extent[i])
+			{
+				start = (size_t)from * (size_t)o_blksize;
+				start -= start % (size_t)extblks;
+				end = (size_t)to * (size_t)o_blksize;
+				(void)madvise(extent[i] + start, end - start, MADV_WILLNEED);
+			}
+		}
+# endif
+		return;
+	}
+#endif
+#ifdef POSIX_FADV_WILLNEED
+	(void)posix_fadvise(fd, (off_t)blkno * o_blksize, (off_t)n * o_blksize, POSIX_FADV_WILLNEED);
+#endif
+}
+
+/* Force the session file's data out to disk.  Only the session file is
+ * flushed, not every dirty buffer in the system the way sync() would.
+ */
+static void flushsession()
+{
+#ifdef FEATURE_MMAP
+	/* start writing the mapped pages; fdatasync() will wait for them */
+	if (mapped)
+	{
+		int	i;
+
+		for (i = 0; i < nextents; i++)
+			if (extent[i])
+				msync(extent[i], (size_t)extblks * (size_t)o_blksize, MS_ASYNC);
+	}
+#endif
+
+#if defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+	(void)fdatasync(fd);
+#else
+	(void)fsync(fd);
+#endif
+	gettimeofday(&lastsync, NULL);
+	syncpending = ElvFalse;
+}
+
+/* Force changes out to disk.  If the "syncdelay" option is set, and the
+ * session file was forced out less than that many milliseconds ago, then
+ * the flush is deferred.  A deferred flush is performed by the first
+ * blksync() call after the delay has expired, or when the session is closed.
+ * This allows a burst of changes to share a single flush.
  */
 void blksync()
 {
+	struct timeval now;
+	long	elapsed;
+
 #ifdef FEATURE_RAM
 	if (nblks > 0)
 		return;
 #endif
+	if (fd < 0)
+		return;
+
+	/* if the session was forced out recently, then defer this flush */
+	if (o_syncdelay > 0)
+	{
+		gettimeofday(&now, NULL);
+		if (now.tv_sec - lastsync.tv_sec <= o_syncdelay / 1000 + 1)
+		{
+			elapsed = (now.tv_sec - lastsync.tv_sec) * 1000L
+				+ (now.tv_usec - lastsync.tv_usec) / 1000L;
+			if (elapsed >= 0 && elapsed < o_syncdelay)
+			{
+				syncpending = ElvTrue;
+				return;
+			}
+		}
+	}
 
-	sync();
+	flushsession();
 }
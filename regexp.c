@@ -74,6 +74,15 @@ static unsigned calcsize(CHAR *text, MARK cursor);
 static int calcminlen(CHAR **scan);
 static int match1(regexp *re, REG _CHAR_ ch, REG int token);
 static int match(regexp *re, MARK str, REG CHAR *prog, CHAR **here, ELVBOOL bol, int endtoken);
+# ifdef FEATURE_LITRE
+static int rank(_CHAR_ ch);
+static void choosefactor(regexp *re);
+static CHAR *scanfactor(regexp *re, CHAR *text, long n, ELVBOOL icase);
+static ELVBOOL factorat(regexp *re, BUFFER buf, long offset, ELVBOOL icase);
+# endif
+static ELVBOOL searchpoll(long n);
+static long searchfwd(regexp *re, BUFFER buf, long offset, ELVBOOL bol, long stop);
+static long searchback(regexp *re, BUFFER buf, long offset, long stop);
 
 # ifdef DEBUG_REGEXP
 static CHAR *decompile(CHAR *prog, int endtoken);
@@ -82,6 +91,9 @@ static CHAR *decompile(CHAR *prog, int endtoken);
 
 
 static CHAR	*previous;	/* the previous regexp, used when null regexp is given */
+#ifdef FEATURE_REGDFA
+static long	serialnum;	/* used to assign serial numbers to regexps */
+#endif
 
 
 /* These are used to classify or recognize meta-characters */
@@ -1235,6 +1247,118 @@ static int calcminlen(scan)
 }
 
 
+#ifdef FEATURE_LITRE
+/* Estimate how common a character is in typical text.  Lower values are
+ * less common.  This is used to choose which character of a required string
+ * to search for first.
+ */
+static int rank(ch)
+	_CHAR_	ch;	/* a character */
+{
+	if (ch == ' ' || ch == 'e' || ch == 't' || ch == 'a' || ch == 'o'
+	 || ch == 'i' || ch == 'n' || ch == 's' || ch == 'r')
+		return 4;
+	if (elvlower(ch) || ch == '\t')
+		return 3;
+	if (elvdigit(ch) || ch == '_' || ch == ',' || ch == '.' || ch == '(' || ch == ')')
+		return 2;
+	if (ch < 128)
+		return 1;
+	return 0;
+}
+
+
+/* This function looks for a run of literal characters which every match of
+ * a compiled regexp must contain, and stores its position in re->factor and
+ * re->factorlen.  If there is more than one, it chooses the longest.  Only
+ * the top level of the regexp is examined, so any regexp with a top-level
+ * \| has no required string.
+ */
+static void choosefactor(re)
+	regexp	*re;	/* the compiled regexp */
+{
+	CHAR	*scan, *start;
+	int	token, k;
+	int	len;		/* length of the current run */
+	ELVBOOL	first;		/* has nothing been consumed yet? */
+	ELVBOOL	runfirst;	/* does the current run start the match? */
+
+	re->factorlen = re->rare = 0;
+	re->prefix = runfirst = ElvFalse;
+	start = NULL;
+	scan = &re->program[1 + 32 * re->program[0]];
+	(void)GET_META(scan);
+	for (scan++, len = 0, first = ElvTrue; ; scan++)
+	{
+		token = GET_META(scan);
+
+		/* a literal character extends the current run */
+		if (!IS_META(token))
+		{
+			if (len++ == 0)
+			{
+				start = scan;
+				runfirst = first;
+			}
+			first = ElvFalse;
+			continue;
+		}
+
+		/* zero-width metacharacters don't break the run */
+		if (token == M_ENDLINE || token == M_BEGWORD || token == M_ENDWORD
+		 || token == M_EDGEWORD || token == M_NOTEDGEWORD
+		 || token == M_LEAVECURSOR)
+			continue;
+
+		/* anything else ends it */
+		if (len > re->factorlen)
+		{
+			re->factor = (int)(start - re->program);
+			re->factorlen = len;
+			re->prefix = runfirst;
+		}
+		len = 0;
+		first = ElvFalse;
+		if (token == M_END(0))
+			break;
+		else if (token == M_ALT(0))
+		{
+			re->factorlen = 0;
+			re->prefix = ElvFalse;
+			return;
+		}
+
+		/* skip a closure's range and operand, or a subexpression */
+		if (token == M_RANGE || token == M_NGRANGE)
+			scan += 2;
+		if (IS_CLOSURE(token))
+		{
+			scan++;
+			token = GET_META(scan);
+		}
+		if (IS_START(token))
+		{
+			k = INDEX_OF(token);
+			do
+			{
+				scan++;
+				token = GET_META(scan);
+				if (token == M_RANGE || token == M_NGRANGE)
+					scan += 2;
+			} while (token != M_END(k));
+		}
+	}
+
+	/* choose the least common character of the string */
+	for (k = 1; k < re->factorlen; k++)
+	{
+		if (rank(re->program[re->factor + k]) < rank(re->program[re->factor + re->rare]))
+			re->rare = k;
+	}
+}
+#endif /* FEATURE_LITRE */
+
+
 /* This function compiles a regexp.  "exp" is the source text of the regular
  * expression.
  */
@@ -1419,8 +1543,8 @@ regexp *regcomp(exp, cursor)
 					memmove(scan+4, scan, (int)(build - scan));
 					build += 4;
 					ADD_META(scan, peek);
-					*build++ = from;
-					*build++ = (to < 255 ? to : 255);
+					*scan++ = from;
+					*scan++ = (to < 255 ? to : 255);
 				}
 				else
 				{
@@ -1540,6 +1664,9 @@ regexp *regcomp(exp, cursor)
 		re->literal = ElvTrue;
 	else
 		re->literal = ElvFalse;
+
+	/* find a string which every match must contain */
+	choosefactor(re);
 #endif
 
 #ifdef DEBUG_REGEXP
@@ -1555,6 +1682,9 @@ regexp *regcomp(exp, cursor)
 #endif
 	scan = &re->program[1 + 32 * re->program[0]];
 	re->minlen = calcminlen(&scan);
+#ifdef FEATURE_REGDFA
+	re->serial = ++serialnum;
+#endif
 
 	return re;
 }
@@ -1911,7 +2041,7 @@ TryAgain:
 
 		/* try to match the minimum number of times */
 		for (nmatched = 0;
-		     nmatched <= to
+		     nmatched < to
 			&& *here
 			&& !match(re, str, prog, here, ElvFalse, END_OF(token));
 		     nmatched++)
@@ -1923,7 +2053,7 @@ TryAgain:
 			 * a stack of the match positions.
 			 */
 			if (IS_GREEDY(closure)
-			 && nmatched >= from)
+			 && nmatched + 1 >= from)
 			{
 				bent = safealloc(1, sizeof *bent);
 				bent->texttail = *scanmark(here);
@@ -1939,7 +2069,7 @@ TryAgain:
 			 * see if the tail also matches.  If so, we're done!
 			 */
 			if (!IS_GREEDY(closure)
-			 && nmatched >= from
+			 && nmatched + 1 >= from
 			 && !match(re, str, tail, here, ElvFalse, endtoken))
 				goto Success;
 		}
@@ -2044,6 +2174,1028 @@ Failure:
 
 
 
+#ifdef FEATURE_REGDFA
+/*---------------------------------------------------------------------------*/
+
+/* The following functions run a compiled regexp as an automaton, instead of
+ * backtracking through match().  The first time a regexp is executed, its
+ * program is translated into a list of simple NFA instructions.  A DFA is
+ * then built from that list lazily, one transition at a time, and is used to
+ * decide whether a line contains a match at all -- for most lines of a
+ * search, that's the only question.  When a line does contain a match, the
+ * NFA is simulated again with capture slots to find the endpoints of the
+ * match and of each subexpression.  Either way, the time taken is
+ * proportional to the length of the line, no matter how the regexp is
+ * written.
+ *
+ * The leftmost match is found.  Among the matches which start there, earlier
+ * alternatives are preferred, and closures match as many repetitions as
+ * possible (or as few as possible, for the non-greedy closures).  A regexp
+ * whose NFA would be too large is still executed via match().
+ */
+
+#define RX_CHAR		0	/* match the character "arg" */
+#define RX_ANY		1	/* match any character except newline */
+#define RX_CLASS	2	/* match a character from class "arg" */
+#define RX_MATCH	3	/* the whole regexp has matched */
+#define RX_JMP		4	/* continue at "x" */
+#define RX_SPLIT	5	/* continue at "x", or else at "y" */
+#define RX_SAVE		6	/* store the position in capture slot "arg" */
+#define RX_ASSERT	7	/* continue if condition "arg" (an M_xxx) holds */
+
+#define RX_MAXINST	3000	/* max NFA instructions; else use match() */
+#define RX_MAXSTATES	200	/* max DFA states before starting over */
+#define RX_HASH		256	/* size of the DFA state hash table */
+#define RX_CACHE	4	/* number of automata to keep */
+#define RX_NSLOT	(2 * NSUBEXP + 1) /* capture slots, including \= */
+#define RX_INFINITY	(-1)	/* maximum count for * and \+ */
+
+#define RXS_PREVWORD	1	/* previous character was part of a word */
+#define RXS_UNANCH	2	/* a match may start at any position */
+#define RXS_STOP	4	/* DFA can stop: matched, or no threads left */
+
+#define RX_ISWORD(c)	((c) == '_' || elvalnum(c))
+
+typedef struct
+{
+	short	op;	/* one of the RX_xxx codes */
+	short	arg;	/* character, class, slot, or M_xxx condition */
+	short	x, y;	/* jump destinations */
+} RXINST;
+
+typedef struct rxstate_s
+{
+	struct rxstate_s *next[256];	/* transitions, or NULL if not built yet */
+	struct rxstate_s *chain;	/* next state in the same hash bucket */
+	int		flags;		/* some RXS_xxx flags */
+	int		npcs;		/* number of NFA threads */
+	short		pc[1];		/* instructions of the threads (varies) */
+} RXSTATE;
+
+typedef struct
+{
+	long	serial;		/* serial number of the regexp, or 0 if unused */
+	ELVBOOL	icase;		/* was it built for ignorecase? */
+	long	used;		/* when it was last used, for LRU replacement */
+	int	ninst;		/* number of NFA instructions, or 0 if too big */
+	int	nsubexp;	/* number of subexpressions, including the whole */
+	RXINST	*inst;		/* the NFA instructions */
+	int	nstates;	/* number of DFA states */
+	RXSTATE	*init[2];	/* initial DFA state, indexed by prevword */
+	RXSTATE	*hash[RX_HASH];	/* DFA states */
+} RXAUTO;
+
+typedef struct
+{
+	short	pc;	/* instruction to visit, or -1 to restore a slot */
+	short	slot;	/* capture slot to restore */
+	int	val;	/* value to restore into that slot */
+} RXSTACK;
+
+typedef struct
+{
+	int	n;	/* number of threads */
+	short	*pc;	/* instruction of each thread */
+	int	*caps;	/* capture slots of each thread, RX_NSLOT apiece */
+} RXLIST;
+
+#if USE_PROTOTYPES
+static int rxemit(int op, int arg);
+static int rxtoken(CHAR **pp);
+static int rxskip(CHAR **pp, int k);
+static CHAR *rxatom(CHAR *p);
+static CHAR *rxrepeat(CHAR *body, int min, int max, ELVBOOL greedy);
+static CHAR *rxseq(CHAR *p, int k);
+static CHAR *rxgroup(CHAR *p, int k);
+static void rxflush(RXAUTO *rx);
+static RXAUTO *rxget(regexp *re);
+static void rxnewgen(void);
+static ELVBOOL rxassert(int token, ELVBOOL prevword, _CHAR_ ch);
+static ELVBOOL rxconsumes(RXAUTO *rx, regexp *re, RXINST *ip, _CHAR_ ch);
+static int rxclosure(RXAUTO *rx, RXSTATE *state, _CHAR_ ch);
+static RXSTATE *rxintern(RXAUTO *rx, short *pcs, int npcs, int flags);
+static RXSTATE *rxstart(RXAUTO *rx, regexp *re, ELVBOOL prevword);
+static RXSTATE *rxstep(RXAUTO *rx, regexp *re, RXSTATE *state, _CHAR_ ch);
+static void rxaddthread(RXAUTO *rx, RXLIST *list, int pc, int *caps, int pos, ELVBOOL prevword, _CHAR_ ch);
+static ELVBOOL rxpike(RXAUTO *rx, regexp *re, int n, ELVBOOL prevword, int *caps);
+static ELVBOOL rxexec(RXAUTO *rx, regexp *re, MARK str, CHAR **here, int len, ELVBOOL bol);
+#endif
+
+static RXAUTO	rxcache[RX_CACHE];/* recently used automata */
+static long	rxclock;	/* used to detect the least recently used */
+static RXSTATE	rxaccept;	/* pseudo-state reached when the DFA matches */
+static jmp_buf	rxtoobig;	/* used when the NFA is too big */
+static RXINST	*rxprog;	/* NFA being compiled */
+static int	rxcount;	/* number of instructions in rxprog */
+static int	rxnsubexp;	/* number of subexpressions in rxprog */
+static int	rxroom;		/* size of the following scratch arrays */
+static int	*rxmark;	/* generation when each instruction was visited */
+static int	rxgen;		/* current generation */
+static RXSTACK	*rxstack;	/* stack of instructions to visit */
+static short	*rxlist;	/* consuming instructions found by rxclosure() */
+static RXLIST	rxthreads[2];	/* threads of the NFA simulation */
+static CHAR	*rxline;	/* copy of the line, for the NFA simulation */
+static int	rxlinesize;	/* size of rxline */
+
+
+/* Add an instruction to the NFA being compiled, and return its index. */
+static int rxemit(op, arg)
+	int	op;	/* one of the RX_xxx codes */
+	int	arg;	/* character, class, slot, or M_xxx condition */
+{
+	if (rxcount >= RX_MAXINST)
+		longjmp(rxtoobig, 1);
+	rxprog[rxcount].op = op;
+	rxprog[rxcount].arg = arg;
+	rxprog[rxcount].x = rxprog[rxcount].y = 0;
+	return rxcount++;
+}
+
+
+/* Fetch a token from a compiled regexp, and advance past it. */
+static int rxtoken(pp)
+	CHAR	**pp;	/* pointer into a compiled regexp */
+{
+	int	token;
+
+	token = GET_META(*pp);
+	(*pp)++;
+	return token;
+}
+
+
+/* Advance *pp to the next M_ALT(k) or M_END(k) token, and return that token.
+ * The token itself isn't skipped.
+ */
+static int rxskip(pp, k)
+	CHAR	**pp;	/* pointer into a compiled regexp */
+	int	k;	/* subexpression number */
+{
+	CHAR	*p;
+	int	token;
+
+	for (p = *pp; ; )
+	{
+		*pp = p;
+		token = rxtoken(&p);
+		if (token == M_ALT(k) || token == M_END(k))
+			return token;
+		if (token == M_RANGE || token == M_NGRANGE)
+			p += 2;
+	}
+}
+
+
+/* Compile a single character or subexpression, and return a pointer to the
+ * token after it.
+ */
+static CHAR *rxatom(p)
+	CHAR	*p;	/* pointer to the item's token */
+{
+	int	token;
+
+	token = rxtoken(&p);
+	if (!IS_META(token))
+		(void)rxemit(RX_CHAR, token);
+	else if (IS_START(token))
+		p = rxgroup(p, INDEX_OF(token));
+	else if (IS_CLASS(token))
+		(void)rxemit(RX_CLASS, token - M_CLASS(0));
+	else switch (token)
+	{
+	  case M_NUL:
+		(void)rxemit(RX_CHAR, '\0');
+		break;
+
+	  case M_ANY:
+		(void)rxemit(RX_ANY, 0);
+		break;
+
+	  case M_LEAVECURSOR:
+		(void)rxemit(RX_SAVE, 2 * NSUBEXP);
+		break;
+
+	  case M_ENDLINE:
+	  case M_BEGWORD:
+	  case M_ENDWORD:
+	  case M_EDGEWORD:
+	  case M_NOTEDGEWORD:
+		(void)rxemit(RX_ASSERT, token);
+		break;
+
+	  default:
+		/* unexpected -- leave it to match() */
+		longjmp(rxtoobig, 1);
+	}
+	return p;
+}
+
+
+/* Compile the body of a closure "min" to "max" times, and return a pointer to
+ * the token after the body.
+ */
+static CHAR *rxrepeat(body, min, max, greedy)
+	CHAR	*body;	/* the closure's character or subexpression */
+	int	min;	/* minimum number of repetitions */
+	int	max;	/* maximum number of repetitions, or RX_INFINITY */
+	ELVBOOL	greedy;	/* prefer more repetitions? */
+{
+	short	split[256];	/* SPLIT instructions of optional repetitions */
+	CHAR	*end;
+	int	i, n, out;
+
+	/* the mandatory repetitions */
+	for (end = body, i = 0; i < min; i++)
+		end = rxatom(body);
+
+	/* the optional repetitions */
+	if (max == RX_INFINITY)
+	{
+		split[0] = rxemit(RX_SPLIT, 0);
+		end = rxatom(body);
+		rxprog[rxemit(RX_JMP, 0)].x = split[0];
+		n = 1;
+	}
+	else
+	{
+		for (n = 0; n < max - min; n++)
+		{
+			split[n] = rxemit(RX_SPLIT, 0);
+			end = rxatom(body);
+		}
+	}
+
+	/* each SPLIT chooses between another repetition, and quitting */
+	out = rxcount;
+	for (i = 0; i < n; i++)
+	{
+		rxprog[split[i]].x = greedy ? split[i] + 1 : out;
+		rxprog[split[i]].y = greedy ? out : split[i] + 1;
+	}
+	return end;
+}
+
+
+/* Compile a sequence of items, up to the next M_ALT(k) or M_END(k), and
+ * return a pointer to that token.
+ */
+static CHAR *rxseq(p, k)
+	CHAR	*p;	/* pointer to the first item's token */
+	int	k;	/* number of the enclosing subexpression */
+{
+	CHAR	*q;
+	int	token;
+
+	for (;;)
+	{
+		q = p;
+		token = rxtoken(&q);
+		if (token == M_ALT(k) || token == M_END(k))
+			return p;
+		switch (token)
+		{
+		  case M_SPLAT:	p = rxrepeat(q, 0, RX_INFINITY, ElvTrue);	break;
+		  case M_PLUS:	p = rxrepeat(q, 1, RX_INFINITY, ElvTrue);	break;
+		  case M_QMARK:	p = rxrepeat(q, 0, 1, ElvTrue);			break;
+		  case M_NGSPLAT:p = rxrepeat(q, 0, RX_INFINITY, ElvFalse);	break;
+		  case M_NGPLUS:p = rxrepeat(q, 1, RX_INFINITY, ElvFalse);	break;
+		  case M_NGQMARK:p = rxrepeat(q, 0, 1, ElvFalse);		break;
+		  case M_RANGE:
+		  case M_NGRANGE:
+			p = rxrepeat(q + 2, q[0], q[1] == 255 ? RX_INFINITY : q[1],
+				(ELVBOOL)(token == M_RANGE));
+			break;
+
+		  default:
+			p = rxatom(p);
+		}
+	}
+}
+
+
+/* Compile subexpression k, and return a pointer to the token after its
+ * M_END(k).
+ */
+static CHAR *rxgroup(p, k)
+	CHAR	*p;	/* pointer to the token after M_START(k) */
+	int	k;	/* subexpression number */
+{
+	CHAR	*q;
+	int	split;	/* SPLIT before an alternative, or -1 */
+	int	jumps;	/* chain of JMPs after alternatives */
+	int	j;
+
+	if (k >= rxnsubexp)
+		rxnsubexp = k + 1;
+	(void)rxemit(RX_SAVE, 2 * k);
+	for (jumps = -1; ; )
+	{
+		/* if another alternative follows, then allow a choice */
+		q = p;
+		split = (rxskip(&q, k) == M_ALT(k)) ? rxemit(RX_SPLIT, 0) : -1;
+
+		/* compile this alternative */
+		p = rxseq(p, k);
+		if (rxtoken(&p) == M_END(k))
+			break;
+
+		/* jump past the remaining alternatives (patched below) */
+		j = rxemit(RX_JMP, 0);
+		rxprog[j].x = jumps;
+		jumps = j;
+		rxprog[split].x = split + 1;
+		rxprog[split].y = rxcount;
+	}
+	while (jumps >= 0)
+	{
+		j = rxprog[jumps].x;
+		rxprog[jumps].x = rxcount;
+		jumps = j;
+	}
+	(void)rxemit(RX_SAVE, 2 * k + 1);
+	return p;
+}
+
+
+/* Free the DFA states of an automaton. */
+static void rxflush(rx)
+	RXAUTO	*rx;	/* the automaton */
+{
+	RXSTATE	*state;
+	int	i;
+
+	for (i = 0; i < RX_HASH; i++)
+	{
+		while ((state = rx->hash[i]) != NULL)
+		{
+			rx->hash[i] = state->chain;
+			safefree(state);
+		}
+	}
+	rx->nstates = 0;
+	rx->init[0] = rx->init[1] = NULL;
+}
+
+
+/* Find the automaton for a regexp, building its NFA if necessary.  Returns
+ * NULL if the regexp should be executed via match() instead.
+ */
+static RXAUTO *rxget(re)
+	regexp	*re;	/* the regexp */
+{
+	RXAUTO	*rx;
+	ELVBOOL	icase;
+	int	i;
+
+	/* is it cached? */
+	icase = (ELVBOOL)(o_ignorecase && !(o_smartcase && re->upper));
+	for (i = 0, rx = rxcache; i < RX_CACHE; i++)
+	{
+		if (rxcache[i].serial == re->serial && rxcache[i].icase == icase)
+		{
+			rxcache[i].used = ++rxclock;
+			return rxcache[i].ninst > 0 ? &rxcache[i] : NULL;
+		}
+		if (rxcache[i].used < rx->used)
+			rx = &rxcache[i];
+	}
+
+	/* reuse the least recently used automaton */
+	if (rx->serial)
+	{
+		rxflush(rx);
+		if (rx->inst)
+			safefree(rx->inst);
+	}
+	rx->serial = re->serial;
+	rx->icase = icase;
+	rx->used = ++rxclock;
+	rx->ninst = 0;
+	rx->inst = NULL;
+
+	/* translate the regexp's program into NFA instructions */
+	rxaccept.flags = RXS_STOP;
+	if (!rxprog)
+		rxprog = (RXINST *)safekept(RX_MAXINST, sizeof(RXINST));
+	rxcount = rxnsubexp = 0;
+	if (setjmp(rxtoobig))
+		return NULL;
+	(void)rxatom(re->program + 1 + 32 * re->program[0]);
+	(void)rxemit(RX_MATCH, 0);
+	rx->ninst = rxcount;
+	rx->nsubexp = rxnsubexp;
+	rx->inst = (RXINST *)safekept(rxcount, sizeof(RXINST));
+	memcpy(rx->inst, rxprog, rxcount * sizeof(RXINST));
+
+	/* make sure the scratch arrays are large enough */
+	if (rxcount > rxroom)
+	{
+		if (rxroom > 0)
+		{
+			safefree(rxmark);
+			safefree(rxstack);
+			safefree(rxlist);
+			for (i = 0; i < 2; i++)
+			{
+				safefree(rxthreads[i].pc);
+				safefree(rxthreads[i].caps);
+			}
+		}
+		rxroom = rxcount;
+		rxmark = (int *)safekept(rxroom, sizeof(int));
+		rxgen = 0;
+		rxstack = (RXSTACK *)safekept(3 * rxroom + 2, sizeof(RXSTACK));
+		rxlist = (short *)safekept(rxroom, sizeof(short));
+		for (i = 0; i < 2; i++)
+		{
+			rxthreads[i].pc = (short *)safekept(rxroom, sizeof(short));
+			rxthreads[i].caps = (int *)safekept(rxroom * RX_NSLOT, sizeof(int));
+		}
+	}
+	return rx;
+}
+
+
+/* Start a new generation of instruction visits */
+static void rxnewgen()
+{
+	if (++rxgen <= 0)
+	{
+		memset(rxmark, 0, rxroom * sizeof(int));
+		rxgen = 1;
+	}
+}
+
+
+/* Test a zero-width condition, given whether the previous character is part
+ * of a word, and the next character.
+ */
+static ELVBOOL rxassert(token, prevword, ch)
+	int	token;	/* the condition, an M_xxx code */
+	ELVBOOL	prevword;/* is the preceding character part of a word? */
+	_CHAR_	ch;	/* the following character */
+{
+	switch (token)
+	{
+	  case M_ENDLINE:	return (ELVBOOL)(ch == '\n');
+	  case M_BEGWORD:	return (ELVBOOL)!prevword;
+	  case M_ENDWORD:	return (ELVBOOL)!RX_ISWORD(ch);
+	  case M_EDGEWORD:	return (ELVBOOL)(prevword != RX_ISWORD(ch));
+	  default:		return (ELVBOOL)(prevword == RX_ISWORD(ch));
+	}
+}
+
+
+/* Test whether a consuming NFA instruction matches a character */
+static ELVBOOL rxconsumes(rx, re, ip, ch)
+	RXAUTO	*rx;	/* the automaton */
+	regexp	*re;	/* the regexp, for its character classes */
+	RXINST	*ip;	/* the instruction */
+	_CHAR_	ch;	/* the character */
+{
+	if (ch == '\n')
+		return ElvFalse;
+	switch (ip->op)
+	{
+	  case RX_ANY:
+		return ElvTrue;
+
+	  case RX_CLASS:
+		return (ELVBOOL)((re->program[1 + 32 * ip->arg + (ch >> 3)] & (1 << (ch & 7))) != 0);
+
+	  case RX_CHAR:
+		return (ELVBOOL)(ch == (_CHAR_)ip->arg
+			|| (rx->icase && elvtolower(ch) == elvtolower(ip->arg)));
+
+	  default:
+		return ElvFalse;
+	}
+}
+
+
+/* Find the consuming instructions reachable from a DFA state's threads when
+ * the next character is "ch", and store them in rxlist[].  Returns the number
+ * of them, or -1 if the MATCH instruction is reachable.
+ */
+static int rxclosure(rx, state, ch)
+	RXAUTO	*rx;	/* the automaton */
+	RXSTATE	*state;	/* the DFA state */
+	_CHAR_	ch;	/* the next character */
+{
+	RXINST	*ip;
+	ELVBOOL	prevword;
+	int	sp, n, pc;
+
+	prevword = (ELVBOOL)((state->flags & RXS_PREVWORD) != 0);
+	rxnewgen();
+	for (sp = 0; sp < state->npcs; sp++)
+		rxstack[sp].pc = state->pc[sp];
+	if (state->flags & RXS_UNANCH)
+		rxstack[sp++].pc = 0;
+	for (n = 0; sp > 0; )
+	{
+		pc = rxstack[--sp].pc;
+		if (rxmark[pc] == rxgen)
+			continue;
+		rxmark[pc] = rxgen;
+		ip = &rx->inst[pc];
+		switch (ip->op)
+		{
+		  case RX_MATCH:
+			return -1;
+
+		  case RX_JMP:
+			rxstack[sp++].pc = ip->x;
+			break;
+
+		  case RX_SPLIT:
+			rxstack[sp++].pc = ip->y;
+			rxstack[sp++].pc = ip->x;
+			break;
+
+		  case RX_SAVE:
+			rxstack[sp++].pc = pc + 1;
+			break;
+
+		  case RX_ASSERT:
+			if (rxassert(ip->arg, prevword, ch))
+				rxstack[sp++].pc = pc + 1;
+			break;
+
+		  default:
+			rxlist[n++] = pc;
+		}
+	}
+	return n;
+}
+
+
+/* Find or create the DFA state for a given set of NFA threads */
+static RXSTATE *rxintern(rx, pcs, npcs, flags)
+	RXAUTO	*rx;	/* the automaton */
+	short	*pcs;	/* sorted instructions of the threads */
+	int	npcs;	/* number of threads */
+	int	flags;	/* RXS_PREVWORD and RXS_UNANCH flags */
+{
+	RXSTATE	*state;
+	unsigned h;
+	int	i;
+
+	/* look for an existing state */
+	for (h = flags, i = 0; i < npcs; i++)
+		h = h * 33 + pcs[i];
+	h %= RX_HASH;
+	for (state = rx->hash[h]; state; state = state->chain)
+	{
+		if ((state->flags & ~RXS_STOP) == flags
+		 && state->npcs == npcs
+		 && !memcmp(state->pc, pcs, npcs * sizeof(short)))
+			return state;
+	}
+
+	/* create a new one */
+	state = (RXSTATE *)safekept(1, sizeof(RXSTATE) + npcs * sizeof(short));
+	state->flags = flags;
+	if (npcs == 0 && !(flags & RXS_UNANCH))
+		state->flags |= RXS_STOP;
+	state->npcs = npcs;
+	memcpy(state->pc, pcs, npcs * sizeof(short));
+	state->chain = rx->hash[h];
+	rx->hash[h] = state;
+	rx->nstates++;
+	return state;
+}
+
+
+/* Return the initial DFA state */
+static RXSTATE *rxstart(rx, re, prevword)
+	RXAUTO	*rx;	/* the automaton */
+	regexp	*re;	/* the regexp */
+	ELVBOOL	prevword;/* is the preceding character part of a word? */
+{
+	short	start;
+
+	if (!rx->init[prevword])
+	{
+		if (rx->nstates >= RX_MAXSTATES)
+			rxflush(rx);
+		start = 0;
+		if (re->bol)
+			rx->init[prevword] = rxintern(rx, &start, 1,
+				prevword ? RXS_PREVWORD : 0);
+		else
+			rx->init[prevword] = rxintern(rx, &start, 0,
+				RXS_UNANCH | (prevword ? RXS_PREVWORD : 0));
+	}
+	return rx->init[prevword];
+}
+
+
+/* Compute a DFA transition which hasn't been built yet.  Note that if there
+ * are too many states, then they're all freed -- including "state".
+ */
+static RXSTATE *rxstep(rx, re, state, ch)
+	RXAUTO	*rx;	/* the automaton */
+	regexp	*re;	/* the regexp, for its character classes */
+	RXSTATE	*state;	/* the current state */
+	_CHAR_	ch;	/* the next character */
+{
+	RXSTATE	*next;
+	int	i, j, n, pc, flags;
+	short	next1;
+
+	/* if MATCH is reachable, then the DFA has found a match */
+	n = rxclosure(rx, state, ch);
+	if (n < 0)
+	{
+		state->next[ch] = &rxaccept;
+		return &rxaccept;
+	}
+
+	/* find the threads which survive this character, and sort them */
+	for (i = j = 0; i < n; i++)
+	{
+		if (rxconsumes(rx, re, &rx->inst[rxlist[i]], ch))
+		{
+			next1 = rxlist[i] + 1;
+			for (pc = j++; pc > 0 && rxlist[pc - 1] > next1; pc--)
+				rxlist[pc] = rxlist[pc - 1];
+			rxlist[pc] = next1;
+		}
+	}
+	flags = (state->flags & RXS_UNANCH) | (RX_ISWORD(ch) ? RXS_PREVWORD : 0);
+
+	/* find or create the state */
+	if (rx->nstates >= RX_MAXSTATES)
+	{
+		rxflush(rx);
+		return rxintern(rx, rxlist, j, flags);
+	}
+	next = rxintern(rx, rxlist, j, flags);
+	state->next[ch] = next;
+	return next;
+}
+
+
+/* Add a thread to a list, following jumps, splits, saves, and zero-width
+ * conditions.  Threads are added in order of priority; an instruction which
+ * is already in the list isn't added again, since the earlier thread there
+ * has a higher priority.  "caps" is modified while this runs, but restored
+ * before it returns.
+ */
+static void rxaddthread(rx, list, pc, caps, pos, prevword, ch)
+	RXAUTO	*rx;	/* the automaton */
+	RXLIST	*list;	/* the list to add to */
+	int	pc;	/* instruction where the thread starts */
+	int	*caps;	/* capture slots of the thread */
+	int	pos;	/* position in the line */
+	ELVBOOL	prevword;/* is the character before "pos" part of a word? */
+	_CHAR_	ch;	/* the character at "pos" */
+{
+	RXINST	*ip;
+	int	sp;
+
+	rxstack[0].pc = pc;
+	for (sp = 1; sp > 0; )
+	{
+		/* pop an instruction, or restore a capture slot */
+		sp--;
+		if (rxstack[sp].pc < 0)
+		{
+			caps[rxstack[sp].slot] = rxstack[sp].val;
+			continue;
+		}
+
+		/* follow non-consuming instructions from there */
+		for (pc = rxstack[sp].pc; rxmark[pc] != rxgen; pc++)
+		{
+			rxmark[pc] = rxgen;
+			ip = &rx->inst[pc];
+			if (ip->op == RX_JMP || ip->op == RX_SPLIT)
+			{
+				if (ip->op == RX_SPLIT)
+					rxstack[sp++].pc = ip->y;
+				pc = ip->x - 1;
+			}
+			else if (ip->op == RX_SAVE)
+			{
+				rxstack[sp].pc = -1;
+				rxstack[sp].slot = ip->arg;
+				rxstack[sp++].val = caps[ip->arg];
+				caps[ip->arg] = pos;
+			}
+			else if (ip->op == RX_ASSERT)
+			{
+				if (!rxassert(ip->arg, prevword, ch))
+					break;
+			}
+			else
+			{
+				/* consuming instruction, or MATCH -- add it */
+				list->pc[list->n] = pc;
+				memcpy(&list->caps[list->n * RX_NSLOT], caps, RX_NSLOT * sizeof(int));
+				list->n++;
+				break;
+			}
+		}
+	}
+}
+
+
+/* Simulate the NFA over the rxline[] buffer, to find the match and its
+ * subexpressions.  The capture slots are stored in caps[].  Returns ElvTrue
+ * if a match was found.
+ */
+static ELVBOOL rxpike(rx, re, n, prevword, caps)
+	RXAUTO	*rx;	/* the automaton */
+	regexp	*re;	/* the regexp, for its character classes */
+	int	n;	/* number of characters in rxline[] */
+	ELVBOOL	prevword;/* is the character before the line part of a word? */
+	int	*caps;	/* where to store the capture slots of the match */
+{
+	RXLIST	*clist, *nlist, *tmp;
+	ELVBOOL	matched;
+	int	pos, i, pc;
+	_CHAR_	ch, nextch;
+
+	clist = &rxthreads[0];
+	nlist = &rxthreads[1];
+	clist->n = 0;
+	rxnewgen();
+	matched = ElvFalse;
+	for (pos = 0; pos < n; pos++)
+	{
+		/* until a match is found, start a new thread at each position,
+		 * with a lower priority than the existing threads.
+		 */
+		ch = rxline[pos];
+		if (!matched && (!re->bol || pos == 0))
+		{
+			for (i = 0; i < RX_NSLOT; i++)
+				caps[i] = -1;
+			rxaddthread(rx, clist, 0, caps, pos, prevword, ch);
+		}
+		if (clist->n == 0 && (matched || re->bol))
+			break;
+
+		/* advance each thread past this character */
+		rxnewgen();
+		nlist->n = 0;
+		prevword = (ELVBOOL)RX_ISWORD(ch);
+		nextch = (pos + 1 < n) ? rxline[pos + 1] : '\0';
+		for (i = 0; i < clist->n; i++)
+		{
+			pc = clist->pc[i];
+			if (rx->inst[pc].op == RX_MATCH)
+			{
+				/* lower-priority threads can't beat this match */
+				memcpy(caps, &clist->caps[i * RX_NSLOT], RX_NSLOT * sizeof(int));
+				matched = ElvTrue;
+				break;
+			}
+			if (rxconsumes(rx, re, &rx->inst[pc], ch))
+				rxaddthread(rx, nlist, pc + 1, &clist->caps[i * RX_NSLOT],
+					pos + 1, prevword, nextch);
+		}
+		tmp = clist;
+		clist = nlist;
+		nlist = tmp;
+	}
+	return matched;
+}
+
+
+/* Search for a match in the rest of a line.  Returns ElvTrue if found, with
+ * the re->startp[], re->endp[], and re->leavep fields set.
+ */
+static ELVBOOL rxexec(rx, re, str, here, len, bol)
+	RXAUTO	*rx;	/* the automaton */
+	regexp	*re;	/* the regexp */
+	MARK	str;	/* where to start searching */
+	CHAR	**here;	/* scanning context, positioned at "str" */
+	int	len;	/* length of the line from "str", excluding newline */
+	ELVBOOL	bol;	/* is "str" at the start of a line? */
+{
+	RXSTATE	*state, *next;
+	ELVBOOL	prevword;
+	MARKBUF	tmp;
+	int	caps[RX_NSLOT];
+	int	i, n;
+
+	/* a match is impossible if the line is too short */
+	if (len < re->minlen)
+		return ElvFalse;
+
+	/* is the character before "str" part of a word? */
+	prevword = ElvFalse;
+	if (!bol && markoffset(str) > 0)
+	{
+		i = scanchar(marktmp(tmp, markbuffer(str), markoffset(str) - 1));
+		prevword = (ELVBOOL)RX_ISWORD(i);
+	}
+
+	/* Include the newline in the scan, if there is one.  A match is only
+	 * detected when the character after it is seen, so the last line of
+	 * a buffer that lacks a newline can't match -- the same as match().
+	 */
+	n = len;
+	if (markoffset(str) + len < o_bufchars(markbuffer(str)))
+		n++;
+
+	/* run the DFA, to see whether there's a match */
+	state = rxstart(rx, re, prevword);
+	for (i = 0; ; i++, scannext(here))
+	{
+		if (i >= n)
+			return ElvFalse;
+		next = state->next[**here];
+		if (!next)
+			next = rxstep(rx, re, state, **here);
+		if (next->flags & RXS_STOP)
+		{
+			if (next != &rxaccept)
+				return ElvFalse;
+			break;
+		}
+		state = next;
+	}
+
+	/* copy the line, and find the match's details via the NFA */
+	if (n > rxlinesize)
+	{
+		if (rxline)
+			safefree(rxline);
+		rxlinesize = n + 256;
+		rxline = (CHAR *)safekept(rxlinesize, sizeof(CHAR));
+	}
+	scanseek(here, str);
+	for (i = 0; i < n; i++, scannext(here))
+		rxline[i] = **here;
+	if (!rxpike(rx, re, n, prevword, caps))
+		return ElvFalse;
+
+	/* Convert the capture slots to offsets.  A subexpression which didn't
+	 * take part in the match (such as an unused alternative) is treated
+	 * as an empty string at the start of the match.
+	 */
+	for (i = 0; i < NSUBEXP; i++)
+	{
+		if (caps[2 * i] >= 0 && caps[2 * i + 1] >= 0)
+		{
+			re->startp[i] = markoffset(str) + caps[2 * i];
+			re->endp[i] = markoffset(str) + caps[2 * i + 1];
+		}
+		else if (i < rx->nsubexp)
+			re->startp[i] = re->endp[i] = re->startp[0];
+		else
+			re->startp[i] = re->endp[i] = -1;
+	}
+	if (caps[2 * NSUBEXP] >= 0)
+		re->leavep = markoffset(str) + caps[2 * NSUBEXP];
+	return ElvTrue;
+}
+#endif /* FEATURE_REGDFA */
+
+
+
+#ifdef FEATURE_LITRE
+/* This function searches "n" characters of contiguous text for the required
+ * string of a regexp, and returns a pointer to the first place where the
+ * whole string occurs, or NULL if it doesn't.  It uses memchr() to look for
+ * the string's least common character, and only compares the rest of the
+ * string where that character is found.
+ */
+static CHAR *scanfactor(re, text, n, icase)
+	regexp	*re;	/* a compiled regexp with a required string */
+	CHAR	*text;	/* the text to search */
+	long	n;	/* length of the text */
+	ELVBOOL	icase;	/* ignore differences in case? */
+{
+	CHAR	*factor = &re->program[re->factor];
+	int	flen = re->factorlen;
+	int	rare = re->rare;
+	CHAR	*scan, *end;
+	int	i;
+
+	if (n < flen)
+		return NULL;
+
+	/* "end" is where the rare character would be for the last possible
+	 * starting position.
+	 */
+	end = text + n - flen + rare;
+	for (scan = text + rare; scan <= end; scan++)
+	{
+		/* find the next occurrence of the rare character */
+		if (!icase || !elvalpha(factor[rare]))
+		{
+			scan = CHARmemchr(scan, factor[rare], (int)(end - scan) + 1);
+			if (!scan)
+				break;
+		}
+		else if (elvtolower(*scan) != elvtolower(factor[rare]))
+			continue;
+
+		/* compare the whole string there */
+		for (i = 0;
+		     i < flen
+			&& (scan[i - rare] == factor[i]
+				|| (icase && elvtolower(scan[i - rare]) == elvtolower(factor[i])));
+		     i++)
+		{
+		}
+		if (i >= flen)
+			return scan - rare;
+	}
+	return NULL;
+}
+
+
+/* This function checks whether a regexp's required string occurs at a given
+ * offset in a buffer, even if it spans a block boundary.
+ */
+static ELVBOOL factorat(re, buf, offset, icase)
+	regexp	*re;	/* a compiled regexp with a required string */
+	BUFFER	buf;	/* the buffer to check */
+	long	offset;	/* where the string might start */
+	ELVBOOL	icase;	/* ignore differences in case? */
+{
+	CHAR	*factor = &re->program[re->factor];
+	CHAR	*scan;
+	MARKBUF	m;
+	int	i;
+
+	scanalloc(&scan, marktmp(m, buf, offset));
+	for (i = 0;
+	     scan && i < re->factorlen
+		&& (*scan == factor[i]
+			|| (icase && elvtolower(*scan) == elvtolower(factor[i])));
+	     i++, scannext(&scan))
+	{
+	}
+	scanfree(&scan);
+	return (ELVBOOL)(i >= re->factorlen);
+}
+
+
+/* This function searches a buffer for the required string of a regexp,
+ * starting at "from".  It returns the offset where the string starts, if
+ * it starts before "stop", or else -1.  The text is searched a block at a
+ * time, without regard for line boundaries.
+ */
+long regfactor(re, from, stop)
+	regexp	*re;	/* a compiled regexp with a required string */
+	MARK	from;	/* where to start searching */
+	long	stop;	/* the string must start before this offset */
+{
+	BUFFER	buf = markbuffer(from);
+	ELVBOOL	icase;
+	CHAR	*scan, *found;
+	MARKBUF	m;
+	long	offset, n, i;
+
+	icase = (ELVBOOL)(o_ignorecase && !(o_smartcase && re->upper));
+	if (stop > o_bufchars(buf) - re->factorlen + 1)
+		stop = o_bufchars(buf) - re->factorlen + 1;
+	offset = markoffset(from);
+	if (offset >= stop)
+		return -1;
+	for (scanalloc(&scan, from); scan; )
+	{
+		/* look for it within this block */
+		n = scanright(&scan);
+		if (n > stop - offset + re->factorlen - 1)
+			n = stop - offset + re->factorlen - 1;
+		found = scanfactor(re, scan, n, icase);
+		if (found)
+		{
+			offset += (long)(found - scan);
+			scanfree(&scan);
+			return offset;
+		}
+
+		/* maybe it spans the end of this block? */
+		for (i = n - re->factorlen + 1; i < n && offset + i < stop; i++)
+		{
+			if (i >= 0 && factorat(re, buf, offset + i, icase))
+			{
+				scanfree(&scan);
+				return offset + i;
+			}
+		}
+
+		/* move on to the next block */
+		offset += n;
+		if (offset >= stop)
+			break;
+		scanseek(&scan, marktmp(m, buf, offset));
+	}
+	scanfree(&scan);
+	return -1;
+}
+#endif /* FEATURE_LITRE */
+
+
 /* This function searches through a string for text that matches a regexp.
  * "re" is the compiled regular expression, "str" is the string to compare
  * against "re", and "bol" is a flag indicating whether "str" points to the
@@ -2059,8 +3211,13 @@ int regexec(re, str, bol)
 	CHAR	*here;	/* pointer used for scanning text */
 #ifdef FEATURE_LITRE
 	int	right;	/* contiguous characters to right of str */
+	CHAR	*found;	/* newline, or required string */
+	long	offset;	/* offset of required string */
 	MARKBUF	m;
 #endif
+#ifdef FEATURE_REGDFA
+	RXAUTO	*rx;	/* automaton for running this regexp */
+#endif
 
 	/* Remember which buffer "str" comes from */
 	re->buffer = markbuffer(str);
@@ -2070,9 +3227,8 @@ int regexec(re, str, bol)
 	scandup(&prog, &here);
 #ifdef FEATURE_LITRE
 	right = scanright(&prog);
-	for (len = 0; len < right && prog[len] != '\n'; len++)
-	{
-	}
+	found = CHARmemchr(prog, '\n', right);
+	len = found ? (int)(found - prog) : right;
 	if (len >= right)
 	{
 		scanseek(&prog, marktmp(m, markbuffer(str), markoffset(str) + len));
@@ -2111,6 +3267,36 @@ int regexec(re, str, bol)
 	/* find the first token of the compiled regular expression */
 	prog = re->program + 1 + 32 * re->program[0];
 
+#ifdef FEATURE_LITRE
+	/* If every match must contain a particular string, then look for that
+	 * string first.  If every match starts with it, then skip to it.
+	 */
+	if (re->factorlen > 0)
+	{
+		if (right >= len)
+		{
+			found = scanfactor(re, here, len,
+				(ELVBOOL)(o_ignorecase && !(o_smartcase && re->upper)));
+			offset = found ? markoffset(str) + (found - here) : -1;
+		}
+		else
+			offset = regfactor(re, str, markoffset(str) + len - re->factorlen + 1);
+		if (offset < 0 || (re->prefix && re->bol && offset > markoffset(str)))
+		{
+			scanfree(&here);
+			return 0;
+		}
+		if (re->prefix && offset > markoffset(str))
+		{
+			len -= (int)(offset - markoffset(str));
+			str = marktmp(m, markbuffer(str), offset);
+			scanseek(&here, str);
+			right = scanright(&here);
+			bol = ElvFalse;
+		}
+	}
+#endif
+
 	/* search for the regexp in the string */
 #ifdef FEATURE_LITRE
 	if (re->literal && re->bol && !o_ignorecase && right >= re->minlen)
@@ -2159,6 +3345,18 @@ int regexec(re, str, bol)
 	}
 	else 
 #endif /* FEATURE_LITRE */
+#ifdef FEATURE_REGDFA
+	if ((rx = rxget(re)) != NULL)
+	{
+		/* run it as an automaton */
+		if (!rxexec(rx, re, str, &here, len, bol))
+		{
+			scanfree(&here);
+			return 0;
+		}
+	}
+	else
+#endif
 	if (re->bol)
 	{
 		/* must occur at BOL */
@@ -2214,6 +3412,267 @@ int regexec(re, str, bol)
 }
 
 
+#define RE_POLLCHARS	16384L	/* characters to scan between guipoll() calls */
+#define RE_BACKCHUNK	65536L	/* size of chunks for backward searches */
+
+/* This is called as a search scans the text, to check whether the user has
+ * interrupted it.  "n" is the number of characters scanned since the last
+ * call.  guipoll() is only called after every RE_POLLCHARS characters, so the
+ * interval between polls depends on the amount of text scanned rather than
+ * on the length of the lines.  Returns ElvTrue if the user has interrupted.
+ */
+static ELVBOOL searchpoll(n)
+	long	n;	/* number of characters scanned since last call */
+{
+	static long	scanned;/* characters scanned since guipoll() was called */
+
+	scanned += n;
+	if (scanned < RE_POLLCHARS)
+		return ElvFalse;
+	scanned = 0;
+	return guipoll(ElvFalse);
+}
+
+
+/* Search forward for the first line which contains a match, starting at
+ * "offset".  Only lines which start before "stop" are searched; "stop" should
+ * be the start of a line, or the end of the buffer.  Returns the offset where
+ * regexec() found the match -- either "offset" itself, or the start of a
+ * later line -- or -1 if there is no match, or -2 if the user interrupted.
+ */
+static long searchfwd(re, buf, offset, bol, stop)
+	regexp	*re;	/* the regexp to search for */
+	BUFFER	buf;	/* the buffer to search */
+	long	offset;	/* where to start searching */
+	ELVBOOL	bol;	/* is "offset" at the start of a line? */
+	long	stop;	/* lines which start here or later aren't searched */
+{
+	MARKBUF	m;
+	long	line;	/* start of a line which might contain a match */
+	long	found;	/* offset of a possible match, or -1 */
+	long	n;
+#if defined(FEATURE_LITRE) || defined(FEATURE_REGDFA)
+	CHAR	*scan;
+#endif
+#ifdef FEATURE_REGDFA
+	RXAUTO	*rx;
+	RXSTATE	*state, *next;
+	CHAR	*p, *end;
+	long	len;
+	ELVBOOL	prevword;
+#endif
+
+	if (stop > o_bufchars(buf))
+		stop = o_bufchars(buf);
+	while (offset < stop)
+	{
+#ifdef FEATURE_LITRE
+		if (re->factorlen > 0)
+		{
+			/* Look for the required string, without regard for line
+			 * boundaries, and then find the start of the line which
+			 * contains it.
+			 */
+			for (found = -1, n = offset; found < 0 && n < stop; n += RE_POLLCHARS)
+			{
+				if (searchpoll(RE_POLLCHARS))
+					return -2;
+				found = regfactor(re, marktmp(m, buf, n),
+					n + RE_POLLCHARS < stop ? n + RE_POLLCHARS : stop);
+			}
+			if (found < 0)
+				return -1;
+			scanalloc(&scan, marktmp(m, buf, found));
+			for (line = found;
+			     line > offset && scanprev(&scan) && *scan != '\n';
+			     line--)
+			{
+			}
+			scanfree(&scan);
+			if (line > offset)
+				bol = ElvTrue;
+		}
+		else
+#endif /* FEATURE_LITRE */
+#ifdef FEATURE_REGDFA
+		if ((rx = rxget(re)) != NULL)
+		{
+			/* Run the DFA over whole blocks.  Newlines are fed to
+			 * the DFA like any other character, since "$" needs to
+			 * see them, but then the DFA starts over.  When the DFA
+			 * gets stuck, we just skip to the next newline.
+			 */
+			prevword = ElvFalse;
+			if (!bol && offset > 0)
+			{
+				n = scanchar(marktmp(m, buf, offset - 1));
+				prevword = (ELVBOOL)RX_ISWORD(n);
+			}
+			state = (bol || !re->bol) ? rxstart(rx, re, prevword) : NULL;
+			line = offset;
+			found = -1;
+			scanalloc(&scan, marktmp(m, buf, offset));
+			for (n = offset; found < 0 && n < stop; )
+			{
+				len = scanright(&scan);
+				if (len > stop - n)
+					len = stop - n;
+				if (searchpoll(len))
+				{
+					scanfree(&scan);
+					return -2;
+				}
+				for (p = scan, end = scan + len; p < end; p++)
+				{
+					if (!state)
+					{
+						p = CHARmemchr(p, '\n', (int)(end - p));
+						if (!p)
+							break;
+					}
+					else
+					{
+						next = state->next[*p];
+						if (!next)
+							next = rxstep(rx, re, state, *p);
+						if (next == &rxaccept)
+						{
+							found = line;
+							break;
+						}
+						state = (next->flags & RXS_STOP) ? NULL : next;
+						if (*p != '\n')
+							continue;
+					}
+
+					/* a new line starts after the newline */
+					line = n + (long)(p - scan) + 1;
+					bol = ElvTrue;
+					state = rxstart(rx, re, ElvFalse);
+				}
+				n += len;
+				if (found < 0 && n < stop)
+					scanseek(&scan, marktmp(m, buf, n));
+			}
+			scanfree(&scan);
+			if (found < 0)
+				return -1;
+		}
+		else
+#endif /* FEATURE_REGDFA */
+		{
+			/* just try each line */
+			if (regexec(re, marktmp(m, buf, offset), bol))
+				return offset;
+			if (searchpoll(re->nextlinep - offset))
+				return -2;
+			offset = re->nextlinep;
+			bol = ElvTrue;
+			continue;
+		}
+
+		/* Check that line for a match.  This also finds the endpoints
+		 * of the match, and the start of the next line.
+		 */
+		if (line >= stop)
+			return -1;
+		if (regexec(re, marktmp(m, buf, line), bol))
+			return line;
+		offset = re->nextlinep;
+		bol = ElvTrue;
+	}
+	return -1;
+}
+
+
+/* Search backward for the last line which starts before "offset" and contains
+ * a match.  Only lines which start at or after "stop" are searched; "offset"
+ * and "stop" should each be the start of a line, or the end of the buffer.
+ * The text is scanned forward a chunk at a time, starting with the chunk just
+ * before "offset".  Returns the offset of the line, or -1 if there is no
+ * match, or -2 if the user interrupted.
+ */
+static long searchback(re, buf, offset, stop)
+	regexp	*re;	/* the regexp to search for */
+	BUFFER	buf;	/* the buffer to search */
+	long	offset;	/* end of the last line to search */
+	long	stop;	/* start of the first line to search */
+{
+	MARKBUF	m;
+	CHAR	*scan;
+	long	begin;	/* start of the chunk being searched */
+	long	line;	/* start of a line with a match */
+	long	found;	/* start of the last line with a match, or -1 */
+
+	while (offset > stop)
+	{
+		/* choose a chunk of whole lines before "offset" */
+		begin = offset - RE_BACKCHUNK;
+		if (begin <= stop)
+			begin = stop;
+		else
+		{
+			scanalloc(&scan, marktmp(m, buf, begin));
+			for (; begin > stop && scanprev(&scan) && *scan != '\n'; begin--)
+			{
+			}
+			scanfree(&scan);
+		}
+
+		/* find the last line in that chunk which contains a match */
+		for (found = -1, line = begin;
+		     (line = searchfwd(re, buf, line, ElvTrue, offset)) >= 0;
+		     line = re->nextlinep)
+		{
+			found = line;
+		}
+		if (line == -2)
+			return -2;
+		if (found >= 0)
+		{
+			(void)regexec(re, marktmp(m, buf, found), ElvTrue);
+			return found;
+		}
+
+		/* continue with the chunk before this one */
+		offset = begin;
+	}
+	return -1;
+}
+
+
+/* Search a buffer for a line which contains a match for a regexp, starting at
+ * "from".  If "forward" is ElvTrue then the first such line which starts
+ * before "stop" is found, though a match is only sought after "from" in the
+ * line which contains it.  Otherwise the last such line which starts before
+ * "from" and at or after "stop" is found.  "stop" should be the start of a
+ * line, or the end of the buffer, and so should "from" for backward searches.
+ *
+ * The text is scanned a block at a time; the lines are only located when a
+ * match is found.  Returns the offset where the match was sought -- "from"
+ * or the start of a line -- with the re->startp[], re->endp[], re->leavep,
+ * and re->nextlinep fields set as though regexec() had been called there.
+ * If there is no match, it returns -1.  If the user interrupts the search,
+ * it returns -2.
+ */
+long regsearch(re, from, stop, forward)
+	regexp	*re;	/* the regexp to search for */
+	MARK	from;	/* where to start searching */
+	long	stop;	/* where to stop searching */
+	ELVBOOL	forward;/* search forward, instead of backward? */
+{
+	MARKBUF	m;
+	ELVBOOL	bol;
+
+	re->buffer = markbuffer(from);
+	if (!forward)
+		return searchback(re, markbuffer(from), markoffset(from), stop);
+	bol = (ELVBOOL)(markoffset(from) == 0
+		|| scanchar(marktmp(m, markbuffer(from), markoffset(from) - 1)) == '\n');
+	return searchfwd(re, markbuffer(from), markoffset(from), bol, stop);
+}
+
+
 /* Report a regexp error.  Metacharacters in the parameter should always be
  * given with a backslash -- this function deletes them if the "magicchar"
  * option indicates that no backslash is necessary.
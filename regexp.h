@@ -23,6 +23,15 @@ typedef struct regexp {
 	ELVBOOL	bol;		/* must start at beginning of line? */
 	ELVBOOL	literal;	/* contains no metacharacters? */
 	ELVBOOL	upper;		/* contains some uppercase letters? */
+#ifdef FEATURE_LITRE
+	int	factor;		/* offset in program[] of a required string */
+	int	factorlen;	/* length of that string, or 0 if none */
+	int	rare;		/* index of its least common character */
+	ELVBOOL	prefix;		/* does every match start with it? */
+#endif
+#ifdef FEATURE_REGDFA
+	long	serial;		/* identifies this regexp's automaton */
+#endif
 	CHAR	program[1];	/* Unwarranted chumminess with compiler. */
 } regexp;
 
@@ -34,6 +43,10 @@ extern int	regexec P_((regexp *re, MARK from, ELVBOOL bol));
 extern CHAR	*regtilde P_((CHAR *newp));
 extern CHAR	*regsub P_((regexp *re, CHAR *newp, ELVBOOL doit));
 extern void	regerror P_((char *errmsg));
+extern long	regsearch P_((regexp *re, MARK from, long stop, ELVBOOL forward));
+#ifdef FEATURE_LITRE
+extern long	regfactor P_((regexp *re, MARK from, long stop));
+#endif
 END_EXTERNC
 
 #ifndef REG
@@ -30,6 +30,75 @@ static struct scan_s *recycle = (struct scan_s *)0;
 MARKBUF	scan__markbuf;
 
 
+/* This is the largest allowed value of the "blkahead" option */
+#define MAXAHEAD	256
+
+/* This describes the block that buffer scans moved into most recently, so
+ * that a scan which steps through a buffer block by block can have the
+ * following blocks read ahead.  It is kept here instead of in the scan
+ * contexts because some commands, such as :g, start a new scan for each line.
+ */
+static struct
+{
+	BUFFER	buffer;	/* buffer containing the block */
+	long	changes;/* value of the buffer's change counter then */
+	long	leo;	/* offset of the block's first character */
+	long	end;	/* offset after the block's last character */
+	int	run;	/* consecutive steps; >0 forward, <0 backward */
+	int	wait;	/* steps left before the next read-ahead */
+} ahead;
+
+#if USE_PROTOTYPES
+static void readahead(BUFFER buf, _BLKNO_ blkno, long leo, long end);
+#endif
+
+/* This is called whenever a buffer scan moves into a different block.  If
+ * the scan has moved to the next block (or the previous one) a few times in
+ * a row, then the blocks after (or before) it are read ahead, and again each
+ * time the scan gets halfway through those blocks.
+ */
+static void readahead(buf, blkno, leo, end)
+	BUFFER	buf;	/* buffer being scanned */
+	_BLKNO_	blkno;	/* the new block */
+	long	leo;	/* offset of the new block's first character */
+	long	end;	/* offset after the new block's last character */
+{
+	BLKNO	blks[MAXAHEAD];
+	int	step, n;
+
+	/* is this the next block, or the previous one, or neither? */
+	step = 0;
+	if (buf == ahead.buffer && buf->changes == ahead.changes)
+	{
+		if (leo == ahead.leo)
+			return;
+		else if (leo == ahead.end)
+			step = 1;
+		else if (end == ahead.leo)
+			step = -1;
+	}
+	if (step == 0 || (step > 0) != (ahead.run > 0))
+		ahead.run = ahead.wait = 0;
+	ahead.run += step;
+	ahead.buffer = buf;
+	ahead.changes = buf->changes;
+	ahead.leo = leo;
+	ahead.end = end;
+
+	/* if it isn't a sequential scan, or isn't time yet, do nothing */
+	if (ahead.run > -2 && ahead.run < 2)
+		return;
+	if (--ahead.wait > 0)
+		return;
+
+	/* read ahead */
+	n = lowahead(bufbufinfo(buf), leo, (ELVBOOL)(step > 0), blks,
+		o_blkahead < MAXAHEAD ? (int)o_blkahead : MAXAHEAD);
+	sesahead(blkno, blks, n);
+	ahead.wait = n > 1 ? n / 2 : MAXAHEAD;
+}
+
+
 #ifdef DEBUG_SCAN
 /* This checks the scan stack, to make sure we aren't scanning a buffer.
  * The lowbuf.c:lockchars() function calls this, since scanning and modifying
@@ -375,6 +444,10 @@ CHAR	*scanseek(cp, restart)
 			{
 				sesunlock(scan__top->blkno, ElvFalse);
 			}
+			if (o_blkahead > 0)
+				readahead(scan__top->buffer, nextblkno,
+					markoffset(restart) - left,
+					markoffset(restart) + right);
 			seslock(nextblkno, ElvFalse, SES_CHARS);
 			scan__top->blkno = nextblkno;
 		}
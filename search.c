@@ -200,18 +200,18 @@ static RESULT forward(win)
 	WINDOW	win;	/* the window to search in */
 {
 	MARKBUF	sbuf;	/* buffer, holds search mark */
-	long	lnum;	/* line number -- used for scanning through buffer */
+	MARKBUF	tmp;	/* start of buffer, for wrapping */
+	long	lnum;	/* line number where the search starts */
 	BLKNO	bi;	/* bufinfo block of the buffer being searched */
-	ELVBOOL	bol;	/* are we at the beginning of a line? */
+	long	endln;	/* offset of the end of the starting line */
+	long	found;	/* result of regsearch() */
 	ELVBOOL	wrapped;/* ElvTrue if we've wrapped at the end of the buffer */
-	long	start;	/* line where we started (detects failure after wrap) */
-	CHAR	*cp;
 
 #ifdef FEATURE_HLSEARCH
 	searchhlflag = ElvTrue;
 #endif
-	/* setup: determine the line number, whether the cursor is at the
-	 * beginning of the line, and where the buffer ends.
+	/* setup: find the search's starting point, and the end of the line
+	 * which contains it.
 	 */
 	sbuf = *win->state->cursor;
 	if (markoffset(&sbuf) + 1 >= o_bufchars(markbuffer(&sbuf)))
@@ -220,51 +220,34 @@ static RESULT forward(win)
 		markaddoffset(&sbuf, 1);
 	bi = bufbufinfo(markbuffer(&sbuf));
 	lnum = markline(&sbuf);
-	bol = (ELVBOOL)(lowline(bi, lnum) == markoffset(&sbuf));
+	endln = (lnum >= o_buflines(markbuffer(&sbuf))
+		? o_bufchars(markbuffer(&sbuf)) : lowline(bi, lnum + 1));
 	wrapped = ElvFalse;
-	start = lnum;
 
-	/* search */
-	scanalloc(&cp, &sbuf);
-	for (;
-	     !regexec(searchre, &sbuf, bol);
-	     marksetoffset(&sbuf, searchre->nextlinep), bol = ElvTrue)
+	/* search from there to the end of the buffer.  If that fails, then
+	 * maybe wrap around to search from the top through the starting line.
+	 */
+	found = regsearch(searchre, &sbuf, o_bufchars(markbuffer(&sbuf)), ElvTrue);
+	if (found == -1)
 	{
-		/* If user gives up, then fail */
-		if (guipoll(ElvFalse))
+		if (!o_wrapscan)
 		{
-			scanfree(&cp);
+			msg(MSG_ERROR, "no match below");
 			return RESULT_ERROR;
 		}
-
-		/* Advance to next line.  Maybe wrap at the bottom of the
-		 * buffer.  This is also where failed searches are detected.
-		 */
-		lnum++;
-		if (wrapped && lnum > start)
+		found = regsearch(searchre, marktmp(tmp, markbuffer(&sbuf), 0L),
+				endln, ElvTrue);
+		if (found == -1)
 		{
-			scanfree(&cp);
 			msg(MSG_ERROR, "no match");
 			return RESULT_ERROR;
 		}
-		else if (lnum > o_buflines(markbuffer(&sbuf)))
-		{
-			if (o_wrapscan)
-			{
-				lnum = 1;
-				searchre->nextlinep = 0L;
-				wrapped = ElvTrue;
-			}
-			else
-			{
-				scanfree(&cp);
-				msg(MSG_ERROR, "no match below");
-				return RESULT_ERROR;
-			}
-		}
-		scanseek(&cp, &sbuf);
+		wrapped = ElvTrue;
 	}
-	scanfree(&cp);
+
+	/* If user gave up, then fail */
+	if (found < 0)
+		return RESULT_ERROR;
 
 	/* if we get here, then the search succeded */
 	marksetoffset(win->state->cursor, searchre->leavep);
@@ -289,16 +272,16 @@ static RESULT backward(win)
 	WINDOW	win;	/* the window to search in */
 {
 	MARKBUF	sbuf;	/* buffer, holds search mark */
+	MARKBUF	tmp;	/* end of buffer, for wrapping */
 	BLKNO	bi;	/* bufinfo block of the buffer being searched */
-	long	lnum;	/* line number -- used for scanning through buffer */
+	long	lnum;	/* line number where the search starts */
 	ELVBOOL	wrapped;/* ElvTrue if we've wrapped at the end of the buffer */
-	long	start;	/* line where we started (detects failure after wrap) */
+	long	found;	/* result of regsearch() */
 	long	endln;	/* offset of the end of a line (really start of next line) */
 	long	last;	/* offset of last match found in a line */
 	long	laststartp;/* offset of the start of the last match in a line */
 	long	lastendp;/* offset of the end of the last match in a line */
 	long	lastleavep;/* offset of the leave position of the last match */
-	CHAR	*cp;	/* used for scanning for newline characters */
 
 #ifdef FEATURE_HLSEARCH
 	searchhlflag = ElvTrue;
@@ -313,7 +296,6 @@ static RESULT backward(win)
 	endln = (lnum == o_buflines(markbuffer(&sbuf))
 		? o_bufchars(markbuffer(&sbuf)) : lowline(bi, lnum + 1));
 	wrapped = ElvFalse;
-	start = lnum;
 
 	/* check for match in same line, to left of cursor */
 	if (regexec(searchre, &sbuf, ElvTrue)
@@ -339,68 +321,33 @@ static RESULT backward(win)
 		return RESULT_COMPLETE;
 	}
 
-	/* search for some other line with a match */
-	scanalloc(&cp, &sbuf);
-	do
+	/* search the preceding lines for a match.  If that fails, then maybe
+	 * wrap around to search from the bottom up through the starting line.
+	 */
+	found = regsearch(searchre, &sbuf, 0L, ElvFalse);
+	if (found == -1)
 	{
-		/* If user gives up, then fail */
-		if (guipoll(ElvFalse))
+		if (!o_wrapscan)
 		{
-			scanfree(&cp);
+			msg(MSG_ERROR, "no match above");
 			return RESULT_ERROR;
 		}
-
-		/* Advance to preceding line.  Maybe wrap at the top of the
-		 * buffer.  This is also where failed searches are detected.
-		 */
-		lnum--;
-		if (wrapped && lnum < start)
+		found = regsearch(searchre,
+			marktmp(tmp, markbuffer(&sbuf), o_bufchars(markbuffer(&sbuf))),
+			markoffset(&sbuf), ElvFalse);
+		if (found == -1)
 		{
-			scanfree(&cp);
 			msg(MSG_ERROR, "no match");
 			return RESULT_ERROR;
 		}
-		else if (lnum < 1)
-		{
-			if (o_wrapscan)
-			{
-				lnum = o_buflines(markbuffer(&sbuf));
-				endln = o_bufchars(markbuffer(&sbuf));
-				wrapped = ElvTrue;
-			}
-			else
-			{
-				scanfree(&cp);
-				msg(MSG_ERROR, "no match above");
-				return RESULT_ERROR;
-			}
-
-			/* find the start of the last line */
-			marksetoffset(&sbuf, lowline(bi, lnum));
-			scanseek(&cp, &sbuf);
-		}
-		else
-		{
-			endln = markoffset(&sbuf);
-			scanprev(&cp);
-			assert(cp && *cp == '\n');
-			do
-			{
-				scanprev(&cp);
-			} while (cp && *cp != '\n');
-			if (cp)
-			{
-				scannext(&cp);
-				sbuf = *scanmark(&cp);
-			}
-			else
-			{
-				marksetoffset(&sbuf, 0L);
-				scanseek(&cp, &sbuf);
-			}
-		}
+		wrapped = ElvTrue;
+	}
 
-	} while (!regexec(searchre, &sbuf, ElvTrue));
+	/* If user gave up, then fail */
+	if (found < 0)
+		return RESULT_ERROR;
+	marksetoffset(&sbuf, found);
+	endln = searchre->nextlinep;
 
 	/* If we get here, then the search succeded -- meaning we have found
 	 * a line which contains at least one match.  Now we need to locate
@@ -415,7 +362,6 @@ static RESULT backward(win)
 		marksetoffset(&sbuf, last + 1);
 	} while (last + 1 < endln
 		&& regexec(searchre, &sbuf, ElvFalse));
-	scanfree(&cp);
 
 	/* move to the last match */
 	marksetoffset(win->state->cursor, last);
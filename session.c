@@ -21,84 +21,432 @@ char id_session[] = "$Id: session.c,v 2.30 2003/10/17 17:41:23 steve Exp $";
 typedef struct blkcache_s
 {
 	struct blkcache_s *next;	/* another block with same hash value */
-	struct blkcache_s *older,*newer;/* the next-older block in the cache */
+	struct blkcache_s *older,*newer;/* the next-older block in its list */
 	COUNT		  locks;	/* lock counter */
 	ELVBOOL		  dirty;	/* does the block need to be rewritten? */
+	ELVBOOL		  hot;		/* in the "hot" list, not "fresh"? */
 	BLKNO		  blkno;	/* block number of this block */
 	BLKTYPE		  blktype;	/* type of data in this block */
 	BLK		  *buf;		/* contents of the block */
+#ifdef FEATURE_MMAP
+	ELVBOOL		  mapped;	/* buf points into the mapped session file */
+#endif
 #ifdef DEBUG_SESSION
 	char		  *lockfile[MAXLOCKS];	/* name of source file that locked block */
 	int		  lockline[MAXLOCKS];	/* line number in source file */
 #endif
 } CACHEENTRY;
 
+/* The cache is divided into two lists, in the manner of the "2Q" algorithm.
+ * A block which is read into the cache goes into the "fresh" list, which is
+ * a FIFO; using it again while it is there doesn't move it.  When it falls
+ * out of the fresh list, its number is remembered for a while in the ghost[]
+ * bitmap.  If it is needed again while still remembered, it goes into the
+ * "hot" list, which is kept in LRU order.  This way, a command which scans
+ * a whole buffer cycles through the fresh list without evicting the blocks
+ * that the display and the buffers' trees use all the time.
+ *
+ * Only text blocks start out in the fresh list.  Superblocks, bufinfo
+ * blocks, and tree blocks are few and are used constantly, so they go
+ * straight into the hot list.  This also keeps them from being written out
+ * in the middle of a change, so a crash leaves the last synced version intact.
+ */
+typedef struct
+{
+	CACHEENTRY	*newest;	/* most recently inserted or used item */
+	CACHEENTRY	*oldest;	/* least recently inserted or used item */
+	int		count;		/* number of items in the list */
+} CACHELIST;
+
 
 #if USE_PROTOTYPES
-static void delcache(CACHEENTRY *item, ELVBOOL thenfree);
+static int cachelimit(void);
+static void unlinkentry(CACHEENTRY *item);
+static void linkentry(CACHEENTRY *item);
+static void rehash(void);
+static void addghost(_BLKNO_ blkno, int limit);
+static CACHEENTRY *victim(int limit);
+static void delcache(CACHEENTRY *item);
 static void addcache(CACHEENTRY *item);
 static CACHEENTRY *findblock(_BLKNO_ blkno);
+static CACHEENTRY *newentry(_BLKNO_ blkno, BLKTYPE blktype);
+# ifdef FEATURE_LAZYLOAD
+static struct backing_s *findbacking(_BLKNO_ blkno);
+static void unback(struct backing_s *bk, _BLKNO_ blkno);
+# endif
 static void flushblock(CACHEENTRY *bc);
+static int freebit(int word, int limit);
 #endif
 
+/* The inuse[] bitmap lets sesalloc() find a free block a whole word at a
+ * time, instead of checking alloccnt[] one block at a time.
+ */
+#define BITS		(8 * (int)sizeof(unsigned long))
+#define NWORDS(n)	(((n) + BITS - 1) / BITS)
+#define SETBIT(b)	(inuse[(b) / BITS] |= 1UL << ((b) % BITS))
+#define CLRBIT(b)	(inuse[(b) / BITS] &= ~(1UL << ((b) % BITS)))
+#define ISGHOST(b)	(ghost[(b) / BITS] & (1UL << ((b) % BITS)))
+#define SETGHOST(b)	(ghost[(b) / BITS] |= 1UL << ((b) % BITS))
+#define CLRGHOST(b)	(ghost[(b) / BITS] &= ~(1UL << ((b) % BITS)))
+
+/* Blocks of these types go straight into the hot list */
+#define HOTTYPE(t)	((t) != SES_CHARS)
+
+/* The fresh list may use this much of the cache before hot blocks are evicted */
+#define FRESHSHARE(limit)	((limit) / 4)
+
+/* These visit every cached item -- the fresh ones, and then the hot ones */
+#define FIRSTENTRY()	(fresh.oldest ? fresh.oldest : hot.oldest)
+#define NEXTENTRY(bc)	((bc)->newer ? (bc)->newer : (bc)->hot ? NULL : hot.oldest)
+
+/* Blocks within this many of the "near" block are preferred for allocation */
+#define NEARWORDS	4
+
 #ifdef DEBUG_SESSION
 static char *blktypename[] =
 {
-"SES_NEW","" "SES_SUPER","" "SES_SUPER2","" "SES_BUFINFO","" "SES_BLKLIST","" "SES_CHARS"
+"SES_NEW","" "SES_SUPER","" "SES_SUPER2","" "SES_BUFINFO","" "SES_BLKLIST","" "SES_CHARS","" "SES_BLKTREE"
 };
 #endif
 
 static long	oldblkhash;	/* previous value of o_blkhash option */
 static CACHEENTRY **hashed;	/* hash table */
-static CACHEENTRY *newest;	/* pointer to newest item in cache */
-static CACHEENTRY *oldest;	/* pointer to oldest item in cache */
+static int	nhashed;	/* size of the hashed[] table */
+static CACHELIST fresh;		/* blocks read once, evicted in FIFO order */
+static CACHELIST hot;		/* blocks needed again, evicted in LRU order */
+static CACHEENTRY *recent;	/* item most recently found by findblock() */
 static int	ncached;	/* number of items in cache */
+static unsigned long *ghost;	/* bitmap of blocks recently evicted from "fresh" */
+static BLKNO	*ghostring;	/* the same blocks, in the order of eviction */
+static int	nghosts;	/* size of the ghostring[] array */
+static int	ghostnext;	/* next slot to use in ghostring[] */
 static COUNT	*alloccnt;	/* array of allocation counts per block */
 static int	nblocks;	/* size of alloccnt array */
+static unsigned long *inuse;	/* bitmap of blocks with nonzero alloccnt[] */
+static int	freeword;	/* no free blocks in inuse[] before this word */
+static int	nextent;	/* number of blocks known to exist in the file */
+static int	nfresh;		/* blocks from here on have never been used */
+static BLKNO	nearblk;	/* next new block should follow this, if possible */
 #ifdef DEBUG_SESSION
 static BLKTYPE	*alloctype;	/* types of blocks, parallel to alloccnt[] */
 #endif
 
 
-/* This function deletes an item from the block cache.  Optionally, it will
- * also free the item.
+#ifdef FEATURE_LAZYLOAD
+/* A lazily loaded file is given a run of consecutive CHARS blocks, but their
+ * text isn't copied into the session file.  Instead, a block is read from the
+ * original file whenever it must be loaded into the cache.  Once a block is
+ * locked for writing, the session file's copy becomes the real one.  Each
+ * block holds "fill" characters except maybe the last, so a block's offset
+ * in the file can be computed from its BLKNO.
  */
-static void delcache(item, thenfree)
-	CACHEENTRY	*item;		/* cache item to be removed from cache */
-	ELVBOOL		thenfree;	/* if ElvTrue, item is freed after removal */
+typedef struct backing_s
 {
-	CACHEENTRY *scan, *lag;
-	int	 i;
+	struct backing_s *next;	/* another lazily loaded file */
+	int	handle;		/* value returned by blkbackopen() */
+	BLKNO	first;		/* first block of the run */
+	int	nblks;		/* number of blocks in the run */
+	int	nlazy;		/* number of blocks still read from the file */
+	long	size;		/* size of the file */
+	long	fill;		/* characters per block */
+	ELVBOOL	changed;	/* has a change to the file been reported? */
+	unsigned long *lazy;	/* bitmap of blocks still read from the file */
+} BACKING;
+
+static BACKING	*backing;	/* list of lazily loaded files */
+
+#define ISLAZY(bk,b)	((bk)->lazy[((b) - (bk)->first) / BITS] & (1UL << (((b) - (bk)->first) % BITS)))
+
+/* Return the BACKING of a block which is still read from its original file,
+ * or NULL if the block's text is in the session file.
+ */
+static BACKING *findbacking(blkno)
+	_BLKNO_	blkno;	/* a block which must be loaded into the cache */
+{
+	BACKING	*bk;
+
+	for (bk = backing; bk; bk = bk->next)
+		if (blkno >= bk->first && blkno < bk->first + bk->nblks)
+			return ISLAZY(bk, blkno) ? bk : NULL;
+	return NULL;
+}
+
+/* Note that a block's text is no longer read from the original file.  When
+ * that is true of every block in the run, the file is released.
+ */
+static void unback(bk, blkno)
+	BACKING	*bk;	/* the lazily loaded file */
+	_BLKNO_	blkno;	/* a block in its run */
+{
+	BACKING	*scan, *lag;
 
-	assert(item != NULL && (item->locks == 0 || !thenfree));
+	bk->lazy[(blkno - bk->first) / BITS] &= ~(1UL << ((blkno - bk->first) % BITS));
+	if (--bk->nlazy > 0)
+		return;
 
-	/* if the item is dirty & we're completely deleting it, then flush it */
-	if (thenfree && item->dirty)
+	for (lag = NULL, scan = backing; scan != bk; lag = scan, scan = scan->next)
 	{
-		blkwrite(item->buf, item->blkno);
-		o_blkwrite++;
 	}
+	if (lag)
+		lag->next = bk->next;
+	else
+		backing = bk->next;
+	blkbackclose(bk->handle);
+	safefree(bk->lazy);
+	safefree(bk);
+}
+
+/* Allocate a run of CHARS blocks for a file which is to be loaded lazily.
+ * Each block holds o_blkfill characters of the file, except maybe the last.
+ * Returns the first block of the run, and stores the number of blocks in
+ * *nblks and the file's size in *size.  Returns 0 if the file can't be
+ * loaded lazily, or is smaller than "minsize".
+ */
+BLKNO seslazy(filename, minsize, nblks, size)
+	char	*filename;	/* name of the file to load */
+	long	minsize;	/* smallest file which should be loaded lazily */
+	int	*nblks;		/* output: number of blocks in the run */
+	long	*size;		/* output: size of the file */
+{
+	BACKING	*bk;
+	int	handle;
+	int	i;
 
-	/* delete the item from the newest/oldest list */
-	if (item == newest)
+	/* open the file.  If too small, then don't bother */
+	handle = blkbackopen(filename, size);
+	if (handle < 0)
+		return 0;
+	if (*size < minsize || *size == 0L
+	 || (*size - 1) / o_blkfill + 1 > (long)INT_MAX - nblocks)
 	{
-		newest = item->older;
+		blkbackclose(handle);
+		return 0;
+	}
+
+	/* describe it */
+	bk = (BACKING *)safealloc(1, sizeof(BACKING));
+	bk->handle = handle;
+	bk->size = *size;
+	bk->fill = o_blkfill;
+	bk->nblks = bk->nlazy = (int)((*size - 1) / o_blkfill + 1);
+	bk->lazy = (unsigned long *)safealloc(NWORDS(bk->nblks), sizeof(unsigned long));
+	for (i = 0; i < bk->nblks; i++)
+		bk->lazy[i / BITS] |= 1UL << (i % BITS);
+
+	/* allocate a run of blocks past the end of the session.  The
+	 * blocks needn't exist in the session file yet.
+	 */
+	bk->first = nblocks;
+	for (i = 0; i < bk->nblks; i++)
+		(void)sesalloc((BLKNO)(bk->first + i), SES_CHARS);
+	bk->next = backing;
+	backing = bk;
+
+	*nblks = bk->nblks;
+	return bk->first;
+}
+
+/* Before a file is overwritten, copy any of its text which hasn't been read
+ * into the session file yet.
+ */
+void sesunlazy(filename)
+	char	*filename;	/* name of a file which is about to be written */
+{
+	BACKING	*bk, *next;
+	CACHEENTRY *bc;
+	BLKNO	blkno;
+	int	i, n;
+
+	for (bk = backing; bk; bk = next)
+	{
+		next = bk->next;
+		if (!blkbacksame(bk->handle, filename))
+			continue;
+
+		/* The last unback() frees bk, so count the blocks here */
+		for (i = bk->nblks, n = bk->nlazy; n > 0 && --i >= 0; )
+		{
+			blkno = bk->first + i;
+			if (!ISLAZY(bk, blkno))
+				continue;
+			(void)seslock(blkno, ElvFalse, SES_CHARS);
+			bc = findblock(blkno);
+			bc->dirty = ElvTrue;
+			sesunlock(blkno, ElvFalse);
+			n--;
+			unback(bk, blkno);
+		}
+	}
+}
+#endif /* FEATURE_LAZYLOAD */
+
+/* Return the maximum number of blocks to keep in the cache.  This is
+ * "blkcachemb" megabytes, but never less than "blkcache" blocks.  Items are
+ * allocated only as they're needed, so a small session never uses it all.
+ */
+static int cachelimit()
+{
+	long	limit;
+
+	limit = o_blkcachemb * (1048576L / o_blksize);
+	return (int)(limit > o_blkcache ? limit : o_blkcache);
+}
+
+/* Remove an item from its list, without freeing it */
+static void unlinkentry(item)
+	CACHEENTRY	*item;	/* item to be removed from its list */
+{
+	CACHELIST *list = item->hot ? &hot : &fresh;
+
+	if (item == list->newest)
+	{
+		list->newest = item->older;
 	}
 	else
 	{
 		item->newer->older = item->older;
 	}
-	if (item == oldest)
+	if (item == list->oldest)
 	{
-		oldest = item->newer;
+		list->oldest = item->newer;
 	}
 	else
 	{
 		item->older->newer = item->newer;
 	}
+	item->older = item->newer = NULL;
+	list->count--;
+}
+
+/* Insert an item at the newest end of its list */
+static void linkentry(item)
+	CACHEENTRY	*item;	/* item to be inserted */
+{
+	CACHELIST *list = item->hot ? &hot : &fresh;
+
+	item->newer = NULL;
+	item->older = list->newest;
+	if (list->newest)
+		list->newest->newer = item;
+	else
+		list->oldest = item;
+	list->newest = item;
+	list->count++;
+}
+
+/* Allocate the hash table, and put each cached block into it.  The table
+ * has at least "blkhash" slots, and grows with the cache so its chains
+ * stay short.
+ */
+static void rehash()
+{
+	CACHEENTRY *scan;
+	int	 i;
+
+	/* free the old hash table, if any */
+	if (hashed)
+	{
+		safefree(hashed);
+	}
+
+	/* allocate a new hash table */
+	nhashed = (int)o_blkhash;
+	if (nhashed <= ncached)
+		nhashed = (ncached * 2) | 1;
+	hashed = (CACHEENTRY **)safekept(nhashed, sizeof(CACHEENTRY *));
+
+	/* put each cached block into the appropriate hash slot */
+	for (scan = FIRSTENTRY(); scan; scan = NEXTENTRY(scan))
+	{
+		i = scan->blkno % nhashed;
+		scan->next = hashed[i];
+		hashed[i] = scan;
+	}
+
+	oldblkhash = o_blkhash;
+}
+
+/* Remember that a block has been evicted from the fresh list.  About half
+ * as many blocks as the cache holds are remembered; older ones are forgotten.
+ */
+static void addghost(blkno, limit)
+	_BLKNO_	blkno;	/* the evicted block */
+	int	limit;	/* current maximum size of the cache */
+{
+	int	i;
+
+	/* if the cache's size has changed, then start over */
+	if (nghosts != limit / 2 + 1)
+	{
+		for (i = 0; i < nghosts; i++)
+			CLRGHOST(ghostring[i]);
+		if (ghostring)
+			safefree(ghostring);
+		nghosts = limit / 2 + 1;
+		ghostring = (BLKNO *)safekept(nghosts, sizeof(BLKNO));
+		ghostnext = 0;
+	}
+
+	/* forget the oldest, and remember this one in its place */
+	CLRGHOST(ghostring[ghostnext]);
+	ghostring[ghostnext] = blkno;
+	SETGHOST(blkno);
+	if (++ghostnext >= nghosts)
+		ghostnext = 0;
+}
+
+/* Choose an unlocked item to evict from the cache.  The oldest fresh item
+ * is chosen while the fresh list has more than its share of the cache,
+ * else the least recently used hot item.  Returns NULL if every item is
+ * locked.
+ */
+static CACHEENTRY *victim(limit)
+	int	limit;	/* current maximum size of the cache */
+{
+	CACHEENTRY *scan;
+	CACHELIST *first, *second;
+
+	if (fresh.count > FRESHSHARE(limit) || hot.count == 0)
+		first = &fresh, second = &hot;
+	else
+		first = &hot, second = &fresh;
+	for (scan = first->oldest; scan && scan->locks > 0; scan = scan->newer)
+	{
+	}
+	if (!scan)
+	{
+		for (scan = second->oldest; scan && scan->locks > 0; scan = scan->newer)
+		{
+		}
+	}
+	return scan;
+}
+
+/* This function deletes an item from the block cache and frees it.  If the
+ * item is dirty, it is written to the session file first.
+ */
+static void delcache(item)
+	CACHEENTRY	*item;		/* cache item to be removed from cache */
+{
+	CACHEENTRY *scan, *lag;
+	int	 i;
+
+	assert(item != NULL && item->locks == 0);
+
+	/* if the item is dirty, then flush it */
+	if (item->dirty)
+	{
+		blkwrite(item->buf, item->blkno);
+		o_blkwrite++;
+	}
+
+	/* delete the item from its list */
+	unlinkentry(item);
+	if (item == recent)
+		recent = NULL;
 
 	/* delete the item from the hashed list */
-	i = item->blkno % o_blkhash;
+	i = item->blkno % nhashed;
 	if (hashed[i] == item)
 	{
 		hashed[i] = item->next;
@@ -112,67 +460,61 @@ static void delcache(item, thenfree)
 		lag->next = scan->next;
 	}
 
-	/* if we're supposed to free it, do that */
-	if (thenfree)
-	{
+	/* free it */
+#ifdef FEATURE_MMAP
+	if (!item->mapped)
+#endif
 		safefree(item->buf);
-		safefree(item);
-	}
-	else
-	{
-		item->older = item->newer = NULL;
-	}
+	safefree(item);
 
 	/* and count it */
 	ncached--;
 }
 
-/* This function adds an item to the "newest" end of the block cache, and also
- * the hash list.  Before it does this, it checks the overall size of the cache
- * and if it has reached the maximum, it tries to delete the oldest unlocked
- * item.
+/* This function adds an item to the "newest" end of its list in the block
+ * cache, and also the hash list.  Before it does this, it checks the overall
+ * size of the cache and if it has reached the maximum, it tries to evict
+ * an unlocked item.
  */
 static void addcache(item)
 	CACHEENTRY	*item;	/* item to be added to cache */
 {
 	CACHEENTRY *scan;
-	int	 i;
+	int	 i, limit;
 
-	/* if this would push the cache past its limit, then try to delete
-	 * the oldest unlocked block.
+	/* if this would push the cache past its limit, then try to evict
+	 * an unlocked block.  Blocks evicted from the fresh list are
+	 * remembered, so they can be recognized as hot if needed again.
 	 */
-	while (ncached >= o_blkcache)
+	limit = cachelimit();
+	while (ncached >= limit)
 	{
-		for (i = 0, scan = oldest; scan && scan->locks > 0; scan = scan->newer, i++)
-		{
-		}
-		if (scan)
+		scan = victim(limit);
+		if (!scan)
 		{
-			delcache(scan, ElvTrue);
-		}
-		else
-		{
-			/* cache size will exceed blkcache... no big deal */
+			/* cache size will exceed limit... no big deal */
 #ifdef DEBUG_SESSION
-			fprintf(stderr, "%d blocks locked\n", i);
+			fprintf(stderr, "%d blocks locked\n", ncached);
 #endif
 			break;
 		}
+		if (!scan->hot && scan->blkno != 0)
+			addghost(scan->blkno, limit);
+		delcache(scan);
+		o_blkevict++;
 	}
 
-	/* if this is the first item in the cache, then this is "oldest" */
-	if (!oldest)
+	/* if the hash chains would get long, then enlarge the hash table */
+	if (!hashed || o_blkhash != oldblkhash || ncached >= 2 * nhashed)
 	{
-		oldest = item;
+		rehash();
 	}
 
-	/* insert this item at the "newest" end of the cache list */
-	item->older = newest;
-	if (newest) newest->newer = item;
-	newest = item;
+	/* insert this item at the "newest" end of its list */
+	linkentry(item);
 
 	/* also insert it into the hash table list */
-	i = item->blkno % o_blkhash;
+	i = item->blkno % nhashed;
 	item->next = hashed[i];
 	hashed[i] = item;
 
@@ -185,50 +527,38 @@ static CACHEENTRY *findblock(blkno)
 	_BLKNO_	blkno;	/* physical block number of block to find */
 {
 	CACHEENTRY *scan;
-	int	 i;
 
-	/* if newest item in cache, return it in a hurry! */
-	if (newest && newest->blkno == blkno)
+	/* if most recently found item in cache, return it in a hurry! */
+	if (recent && recent->blkno == blkno)
 	{
 		o_blkhit++;
-		return newest;
+		return recent;
 	}
 
 	/* reallocate the hash table if first call or blkhash has changed */
 	if (!hashed || o_blkhash != oldblkhash)
 	{
-		/* free the old hash table, if any */
-		if (hashed)
-		{
-			safefree(hashed);
-		}
-
-		/* allocate a new hash table */
-		hashed = (CACHEENTRY **)safekept((int)o_blkhash, sizeof(CACHEENTRY *));
-
-		/* put each cached block into the appropriate hash slot */
-		for (scan = oldest; scan; scan = scan->newer)
-		{
-			i = scan->blkno % o_blkhash;
-			scan->next = hashed[i];
-			hashed[i] = scan;
-		}
-
-		oldblkhash = o_blkhash;
+		rehash();
 	}
 
 	/* search for the block */
-	for (scan = hashed[blkno % o_blkhash];
+	for (scan = hashed[blkno % nhashed];
 	     scan && scan->blkno != blkno;
 	     scan = scan->next)
 	{
 	}
 
-	/* if found, move it to the newest end of the cache list */
+	/* if found and hot, move it to the newest end of the hot list.
+	 * Fresh blocks stay where they are.
+	 */
 	if (scan)
 	{
-		delcache(scan, ElvFalse);
-		addcache(scan);
+		if (scan->hot && scan != hot.newest)
+		{
+			unlinkentry(scan);
+			linkentry(scan);
+		}
+		recent = scan;
 		o_blkhit++;
 		return scan;
 	}
@@ -237,6 +567,29 @@ static CACHEENTRY *findblock(blkno)
 	return NULL;
 }
 
+/* Add a cache item for a block without reading it from the session file.
+ * The item's buffer is initially zeroed, unless the session file is mapped.
+ */
+static CACHEENTRY *newentry(blkno, blktype)
+	_BLKNO_	blkno;	/* physical block number of the block */
+	BLKTYPE	blktype;/* type of data in this block */
+{
+	CACHEENTRY *newp;
+
+	newp = (CACHEENTRY *)safealloc(1, sizeof(CACHEENTRY));
+#ifdef FEATURE_MMAP
+	if ((newp->buf = blkptr(blkno)) != NULL)
+		newp->mapped = ElvTrue;
+	else
+#endif
+		newp->buf = (BLK *)safealloc((int)o_blksize, sizeof(char));
+	newp->blkno = blkno;
+	newp->blktype = blktype;
+	newp->hot = HOTTYPE(blktype);
+	addcache(newp);
+	return newp;
+}
+
 /*----------------------------------------------------------------------------*/
 /* Open a session file.  For any error, issue an error message and
  * exit without ever returning.
@@ -245,6 +598,7 @@ void sesopen(force)
 	ELVBOOL	force;		/* if ElvTrue, open even if "in use" flag is set */
 {
 	BLK	*tmp;
+	long	magic;
 
 	/* allocate a temporary buffer for the superblock */
 	tmp = (BLK *)safealloc((int)o_blksize, sizeof(char));
@@ -257,6 +611,18 @@ void sesopen(force)
 		msg(MSG_FATAL, "already in use");
 	}
 
+	/* if the session file uses some other format, then we can't use it.
+	 * Release it first, so the "in use" flag doesn't keep it locked.
+	 */
+	if (tmp->super.magic != SESSION_MAGIC)
+	{
+		magic = tmp->super.magic;
+		blkclose(tmp);
+		if (magic == SESSION_MAGIC_BYTESWAPPED)
+			msg(MSG_FATAL, "session file was created on a different type of CPU");
+		msg(MSG_FATAL, "session file was created by an incompatible version of elvis");
+	}
+
 	/* use the block size denoted in the superblock */
 	o_blksize = tmp->super.blksize;
 	o_blkfill = SES_MAXCHARS * 9/10;
@@ -270,8 +636,11 @@ void sesopen(force)
 #ifdef DEBUG_SESSION
 	alloctype = (BLKTYPE *)safealloc(1, sizeof(BLKTYPE));
 #endif
-	nblocks = 1;
+	inuse = (unsigned long *)safealloc(1, sizeof(unsigned long));
+	ghost = (unsigned long *)safealloc(1, sizeof(unsigned long));
+	nblocks = nextent = nfresh = 1;
 	alloccnt[0] = 1; /* so superblock is always allocated */
+	SETBIT(0);
 #ifdef DEBUG_SESSION
 	alloctype[0] = SES_SUPER;
 #endif
@@ -314,6 +683,9 @@ BLKNO seslock(blkno, forwrite, blktype)
 	BLKTYPE	blktype;	/* type of data in the block */
 {
 	CACHEENTRY *bc, *newp;
+#ifdef FEATURE_LAZYLOAD
+	BACKING	*bk;
+#endif
 
 #ifdef LOG_SESSION
 	fprintf(stderr, "%s:%d: seslock(%d, %s, %s)...\n", file, line,
@@ -339,35 +711,89 @@ BLKNO seslock(blkno, forwrite, blktype)
 	if (!bc)
 	{
 		bc = (CACHEENTRY *)safekept(1, sizeof(CACHEENTRY));
-		bc->buf = (BLK *)safekept((int)o_blksize, sizeof(char));
 		bc->blkno = blkno;
 		bc->blktype = blktype;
-		blkread(bc->buf, bc->blkno);
+
+		/* if evicted recently and needed again already, it's hot */
+		bc->hot = HOTTYPE(blktype);
+		if (ISGHOST(blkno))
+		{
+			bc->hot = ElvTrue;
+			CLRGHOST(blkno);
+		}
+#ifdef FEATURE_LAZYLOAD
+		bk = backing ? findbacking(blkno) : NULL;
+#endif
+#ifdef FEATURE_MMAP
+		/* if the session file is mapped, use the block in place.
+		 * A lazily loaded block gets a buffer of its own, so its
+		 * text isn't copied into the session file unless changed.
+		 */
+		if (
+# ifdef FEATURE_LAZYLOAD
+		    !bk &&
+# endif
+		    (bc->buf = blkptr(blkno)) != NULL)
+			bc->mapped = ElvTrue;
+		else
+#endif
+		{
+			bc->buf = (BLK *)safekept((int)o_blksize, sizeof(char));
+#ifdef FEATURE_LAZYLOAD
+			if (!bk)
+#endif
+				blkread(bc->buf, bc->blkno);
+		}
+#ifdef FEATURE_LAZYLOAD
+		/* if its text is still in the original file, then read it
+		 * from there.
+		 */
+		if (bk)
+		{
+			if (!blkbackread(bk->handle, bc->buf,
+				(long)(blkno - bk->first) * bk->fill,
+				(int)(blkno + 1 - bk->first < (BLKNO)bk->nblks
+					? bk->fill
+					: bk->size - (long)(bk->nblks - 1) * bk->fill))
+			 && !bk->changed)
+			{
+				bk->changed = ElvTrue;
+				msg(MSG_WARNING, "a lazily loaded file has been changed by another program");
+			}
+		}
+#endif
 		addcache(bc);
 	}
 
+#ifdef FEATURE_LAZYLOAD
+	/* once it is changed, the session file has the real text */
+	if (forwrite && alloccnt[blkno] == 1 && backing && (bk = findbacking(blkno)) != NULL)
+		unback(bk, blkno);
+#endif
+
 	/* if for write, and its allocation count is greater than 1, then
 	 * "copy on write" means we have to copy this block right now.
 	 */
 	if (forwrite && alloccnt[blkno] > 1)
 	{
-		/* copy-on-write should only be necessary for CHARS blocks */
-		assert(blktype == SES_CHARS);
+		/* copy-on-write should only be necessary for CHARS blocks, and
+		 * for BLKLIST and BLKTREE blocks shared by several versions of
+		 * a buffer.  For those, the caller must add a reference to each
+		 * block that the copy refers to.
+		 */
+		assert(blktype == SES_CHARS || blktype == SES_BLKLIST || blktype == SES_BLKTREE);
 
 		/* decrement the allocation count of the old block */
 		alloccnt[blkno]--;
 
-		/* allocate a new block */
+		/* allocate a new block.  This leaves it in the cache.  Keep
+		 * the old block locked meanwhile, so it won't be evicted.
+		 */
+		bc->locks++;
 		blkno = sesalloc(0, blktype);
+		bc->locks--;
 		newp = findblock(blkno);
-		if (!newp)
-		{
-			newp = (CACHEENTRY *)safealloc(1, sizeof(CACHEENTRY));
-			newp->buf = (BLK *)safealloc((int)o_blksize, sizeof(char));
-			newp->blkno = blkno;
-			newp->blktype = blktype;
-			addcache(newp);
-		}
+		assert(newp != NULL);
 
 		/* copy the old block's contents into the new block */
 		memcpy(newp->buf, bc->buf, (size_t)o_blksize);
@@ -399,6 +825,16 @@ BLKNO seslock(blkno, forwrite, blktype)
 	return blkno;
 }
 
+/* Return the allocation count of a block.  For a BLKLIST or BLKTREE block,
+ * this is the number of trees which share it.  Blocks which haven't been
+ * allocated yet have a count of 0.
+ */
+int sesrefs(blkno)
+	_BLKNO_	blkno;	/* BLKNO of a block */
+{
+	return (int)blkno < nblocks ? alloccnt[blkno] : 0;
+}
+
 /* Return a pointer to the start of a block's data in the cache */
 BLK *sesblk(blkno)
 	_BLKNO_	blkno;	/* BLKNO of desired block */
@@ -455,8 +891,11 @@ void sesflush(blkno)
 	bc = findblock(blkno);
 	assert(bc != NULL && bc->locks == 0);
 
-	/* if SES_CHARS or SES_BLKLIST, and not dirty, then don't bother */
-	if ((bc->blktype == SES_CHARS || bc->blktype == SES_BLKLIST)
+	/* if SES_CHARS, SES_BLKLIST, or SES_BLKTREE and not dirty, then don't
+	 * bother
+	 */
+	if ((bc->blktype == SES_CHARS || bc->blktype == SES_BLKLIST
+		|| bc->blktype == SES_BLKTREE)
 	    && !bc->dirty)
 	{
 		return;
@@ -473,7 +912,7 @@ void sessync()
 	safeinspect();
 
 	/* for each block... */
-	for (bc = oldest; bc; bc = bc->newer)
+	for (bc = FIRSTENTRY(); bc; bc = NEXTENTRY(bc))
 	{
 #ifdef DEBUG_SESSION
 		if (bc->locks > 0)
@@ -512,9 +951,148 @@ void sessync()
 	}
 }
 
+/* Describe the block cache, for the :cachestat command.  If "reset" is
+ * ElvTrue, then the statistics are zeroed afterward.
+ */
+void sesstats(reset)
+	ELVBOOL	reset;	/* zero the counters? */
+{
+	CACHEENTRY *bc;
+	long	dirty, total;
+
+	for (dirty = 0, bc = FIRSTENTRY(); bc; bc = NEXTENTRY(bc))
+		if (bc->dirty)
+			dirty++;
+	msg(MSG_INFO, "[ddddd]cache holds $1 of $2 blocks of $3 bytes, $4 hot, $5 dirty",
+		(long)ncached, (long)cachelimit(), o_blksize, (long)hot.count, dirty);
+	total = o_blkhit + o_blkmiss;
+	msg(MSG_INFO, "[ddd]$1 hits, $2 misses, $3% hit rate",
+		o_blkhit, o_blkmiss, total > 0 ? o_blkhit * 100 / total : 0L);
+	msg(MSG_INFO, "[ddd]$1 evictions, $2 writes, $3 hash slots",
+		o_blkevict, o_blkwrite, (long)nhashed);
+	if (reset)
+		o_blkhit = o_blkmiss = o_blkevict = o_blkwrite = 0;
+}
+
+/* Give the OS a hint that some blocks will be needed soon, so it can start
+ * reading them in the background.  Blocks which are already in the cache are
+ * skipped, and runs of consecutive blocks are described by a single hint.
+ * This doesn't load anything into the cache itself.
+ */
+void sesahead(from, blks, n)
+	_BLKNO_	from;	/* block being used now */
+	BLKNO	*blks;	/* blocks which will be needed soon, in order */
+	int	n;	/* number of items in blks[] */
+{
+	CACHEENTRY *bc;
+	BLKNO	blkno, lo, hi;
+	int	i;
+#ifdef FEATURE_LAZYLOAD
+	BACKING	*bk, *runbk = NULL;
+#endif
+
+	/* The OS reads ahead by itself when a file is read in order, so
+	 * skip any blocks which simply follow "from" in the file.
+	 */
+	for (i = 0; i < n && blks[i] == from + 1 + i; i++)
+	{
+	}
+
+	/* an extra pass with blkno=0 issues the hint for the last run */
+	for (lo = hi = 0; i <= n; i++)
+	{
+		/* skip blocks which are already cached.  Don't use findblock()
+		 * for this, since that would affect the statistics.
+		 */
+		blkno = 0;
+		if (i < n)
+		{
+			blkno = blks[i];
+			for (bc = hashed ? hashed[blkno % nhashed] : NULL;
+			     bc && bc->blkno != blkno;
+			     bc = bc->next)
+			{
+			}
+			if (bc)
+				continue;
+		}
+#ifdef FEATURE_LAZYLOAD
+		bk = (blkno && backing) ? findbacking(blkno) : NULL;
+#endif
+
+		/* if adjacent to the current run, then just extend the run */
+		if (lo && blkno && (blkno + 1 == lo || blkno == hi + 1)
+#ifdef FEATURE_LAZYLOAD
+		 && bk == runbk
+#endif
+			)
+		{
+			if (blkno < lo)
+				lo = blkno;
+			else
+				hi = blkno;
+			continue;
+		}
+
+		/* issue a hint for the current run, and start a new one */
+		if (lo)
+		{
+#ifdef FEATURE_LAZYLOAD
+			if (runbk)
+				blkbackahead(runbk->handle,
+					(long)(lo - runbk->first) * runbk->fill,
+					(long)(hi + 1 - lo) * runbk->fill);
+			else
+#endif
+				blkahead(lo, (int)(hi + 1 - lo));
+		}
+		lo = hi = blkno;
+#ifdef FEATURE_LAZYLOAD
+		runbk = bk;
+#endif
+	}
+}
+
 /*----------------------------------------------------------------------------*/
 
 
+/* Return the number of the first free block in inuse[], starting the search
+ * at a given word and giving up before the limit word.  Returns -1 if there
+ * is no free block in that range.
+ */
+static int freebit(word, limit)
+	int	word;	/* index of first word of inuse[] to check */
+	int	limit;	/* index of word after the last one to check */
+{
+	unsigned long bits;
+	int	i;
+
+	if (limit > NWORDS(nblocks))
+		limit = NWORDS(nblocks);
+	for (; word < limit; word++)
+	{
+		if ((bits = inuse[word]) != ~0UL)
+		{
+			for (i = 0; bits & 1UL; i++, bits >>= 1)
+			{
+			}
+			return word * BITS + i;
+		}
+	}
+	return -1;
+}
+
+/* Give a hint that the next new block is logically adjacent to blkno, such
+ * as the next CHARS block of the same buffer.  sesalloc() will then prefer
+ * a free block just after blkno, so that reading the buffer sequentially
+ * tends to read the session file sequentially too.
+ */
+void sesnear(blkno)
+	_BLKNO_	blkno;	/* a block that the next new block should follow */
+{
+	nearblk = blkno;
+}
+
 /* Allocate a new block (if blkno is 0) or increment the allocation
  * count on an existing block (if blkno is not 0).  Returns its BLKNO.
  */
@@ -533,18 +1111,35 @@ BLKNO sesalloc(blkwant, blktype)
 	BLKNO	blkno;
 	int	newsize;
 	COUNT	*newarray;
-	BLK	*tmp;
+	unsigned long *newbits, *newghost;
+	CACHEENTRY *bc;
 	int	i;
 #ifdef DEBUG_SESSION
 	BLKTYPE	*newtypes;
 #endif
 
-	/* if we're supposed to choose a block, then choose one */
+	/* if we're supposed to choose a block, then choose one.  Prefer a
+	 * free block shortly after the "near" block, else use the first
+	 * free block.  The inuse[] bitmap has an extra 0 bit past the end
+	 * unless nblocks is a multiple of BITS, so if every block is in
+	 * use then this chooses nblocks.
+	 */
 	if (blkwant == 0)
 	{
-		for (blkno = 1; blkno < nblocks && alloccnt[blkno] > 0; blkno++)
+		i = -1;
+		if (nearblk != 0 && (int)nearblk + 1 < nblocks)
+		{
+			i = (int)nearblk + 1;
+			if (inuse[i / BITS] & (1UL << (i % BITS)))
+				i = freebit(i / BITS, i / BITS + NEARWORDS);
+		}
+		nearblk = 0;
+		if (i < 0)
 		{
+			i = freebit(freeword, NWORDS(nblocks));
+			freeword = (i < 0 ? NWORDS(nblocks) : i / BITS);
 		}
+		blkno = (i < 0 || i > nblocks) ? nblocks : i;
 	}
 	else
 	{
@@ -552,45 +1147,73 @@ BLKNO sesalloc(blkwant, blktype)
 	}
 #ifdef DEBUG_SESSION
 	assert(blkno >= nblocks || alloctype[blkno] == SES_NEW
-		|| (alloctype[blkno] == SES_CHARS && blktype == SES_CHARS && alloccnt[blkno] > 0));
+		|| (alloctype[blkno] == blktype && alloccnt[blkno] > 0
+			&& (blktype == SES_CHARS || blktype == SES_BLKLIST || blktype == SES_BLKTREE)));
 #endif
 
-	/* if past the end of the current alloccnt array, then grow */
+	/* if past the end of the current alloccnt array, then grow.  Grow
+	 * in proportion to the current size, so a large session doesn't
+	 * spend all its time copying these arrays.
+	 */
 	if (blkno >= nblocks)
 	{
 		/* reallocate the alloccnt array */
-		newsize = blkno + o_blkgrow - (blkno % o_blkgrow);
+		newsize = blkno + 1 + nblocks / 8;
+		newsize += o_blkgrow - (newsize % o_blkgrow);
 		assert(newsize > blkno);
 		newarray = (COUNT *)safekept(newsize, sizeof(COUNT));
+		newbits = (unsigned long *)safekept(NWORDS(newsize), sizeof(unsigned long));
+		newghost = (unsigned long *)safekept(NWORDS(newsize), sizeof(unsigned long));
 #ifdef DEBUG_SESSION
 		newtypes = (BLKTYPE *)safekept(newsize, sizeof(BLKTYPE));
 #endif
-		for (i = 0; i < nblocks; i++)
-		{
-			newarray[i] = alloccnt[i];
+		memcpy(newarray, alloccnt, nblocks * sizeof(COUNT));
+		memcpy(newbits, inuse, NWORDS(nblocks) * sizeof(unsigned long));
+		memcpy(newghost, ghost, NWORDS(nblocks) * sizeof(unsigned long));
 #ifdef DEBUG_SESSION
+		for (i = 0; i < nblocks; i++)
 			newtypes[i] = alloctype[i];
 #endif
-		}
 		safefree(alloccnt);
 		alloccnt = newarray;
+		safefree(inuse);
+		inuse = newbits;
+		safefree(ghost);
+		ghost = newghost;
 #ifdef DEBUG_SESSION
 		safefree(alloctype);
 		alloctype = newtypes;
 #endif
 		nblocks = newsize;
+	}
+
+	/* if new block requested, make sure the session file contains it,
+	 * and a few more after it.  Preallocating these is much faster than
+	 * writing dummy blocks one at a time.
+	 */
+	if (blkwant == 0 && blkno >= nextent)
+	{
+		blkextend((BLKNO)nextent, (BLKNO)nblocks);
+		nextent = nblocks;
+	}
+	else if (blkno >= nextent)
+	{
+		/* recovery marks blocks that already exist in the file */
+		nextent = blkno + 1;
+	}
 
-		/* if new block requested, write dummy data into the session file */
+	/* mark the block as being in use */
+	if (alloccnt[blkno] == 0)
+		SETBIT(blkno);
+
+	/* a block that has never been used is already zeroed */
+	if (blkno >= nfresh)
+	{
+		nfresh = blkno + 1;
+
+		/* put it in the cache, so it won't be read */
 		if (blkwant == 0)
-		{
-			tmp = (BLK *)safealloc((int)o_blksize, sizeof(char));
-			for (i = blkno; i < nblocks; i++)
-			{
-				blkwrite(tmp, (BLKNO)i);
-				o_blkwrite++;
-			}
-			safefree(tmp);
-		}
+			(void)newentry(blkno, blktype);
 
 		/* increment the allocation counter for the chosen block */
 		alloccnt[blkno]++;
@@ -615,13 +1238,17 @@ BLKNO sesalloc(blkwant, blktype)
 		alloctype[blkno] = blktype;
 #endif
 
-		/* if block is supposed to be new, then zero it */
+		/* if block is supposed to be new, then zero it.  There's no
+		 * need to read its old contents first.
+		 */
 		if (blkwant == 0)
 		{
-			(void)seslock(blkno, ElvTrue, blktype);
-			tmp = sesblk(blkno);
-			memset((char *)tmp, 0, (size_t)o_blksize);
-			sesunlock(blkno, ElvTrue);
+			CLRGHOST(blkno);
+			if ((bc = findblock(blkno)) == NULL)
+				bc = newentry(blkno, blktype);
+			bc->blktype = blktype;
+			memset((char *)bc->buf, 0, (size_t)o_blksize);
+			bc->dirty = ElvTrue;
 		}
 
 #ifdef LOG_SESSION
@@ -655,8 +1282,23 @@ void sesfree(blkno)
 	fprintf(stderr, "%s:%d: sesfree(%d), alloccnt[%d]=%d\n",
 		file, line, blkno, blkno, alloccnt[blkno]);
 #endif
-#ifdef DEBUG_SESSION
+
+	/* if now unused, then make it available to sesalloc() */
 	if (alloccnt[blkno] == 0)
+	{
+		CLRBIT(blkno);
+		if ((int)blkno / BITS < freeword)
+			freeword = blkno / BITS;
+#ifdef FEATURE_LAZYLOAD
+		if (backing)
+		{
+			BACKING	*bk = findbacking(blkno);
+			if (bk)
+				unback(bk, blkno);
+		}
+#endif
+#ifdef DEBUG_SESSION
 		alloctype[blkno] = SES_NEW;
 #endif
+	}
 }
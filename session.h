@@ -19,7 +19,11 @@
 #endif
 
 #ifndef BLKCACHE
-# define BLKCACHE	20	/* default size of block cache */
+# define BLKCACHE	32	/* default minimum size of block cache, in blocks */
+#endif
+
+#ifndef BLKCACHEMB
+# define BLKCACHEMB	16	/* default size of block cache, in megabytes */
 #endif
 
 #ifndef BLKGROW
@@ -29,25 +33,47 @@
 /*----------------------------------------------------------------------------*/
 /* session file format                                                        */
 
-#define SESSION_MAGIC			0x0200DEADL
-#define SESSION_MAGIC_BYTESWAPPED	0xADDE0002L
+#define SESSION_MAGIC			0x0302DEADL
+#define SESSION_MAGIC_BYTESWAPPED	0xADDE0203L
 
 /* These data types are used to represent physical and logical block numbers.
  * BLKNO is a physical block number; it is used to compute an offset into the
  * session file.  LBLKNO is a logical block number; it is an index into a
  * blklist block for a given buffer.  DON'T CONFUSE ONE FOR THE OTHER.
+ *
+ * Both are 32 bits wide.  Older versions of elvis used 16-bit values here,
+ * which limited a session file to 65535 blocks; SESSION_MAGIC was changed
+ * when the format was widened, so old session files are rejected by sesopen().
+ * The nchars and nlines counts in a blklist can never exceed o_blksize, so
+ * they're still COUNTs; that keeps each blk[] element down to 8 bytes.
+ */
+#if UINT_MAX >= 0xffffffffUL
+typedef unsigned int	SESWORD;
+typedef unsigned int	_SESWORD_;
+#else
+typedef unsigned long	SESWORD;
+typedef unsigned long	_SESWORD_;
+#endif
+typedef SESWORD BLKNO;
+typedef SESWORD LBLKNO;
+typedef _SESWORD_ _BLKNO_;
+typedef _SESWORD_ _LBLKNO_;
+typedef enum { SES_NEW, SES_SUPER, SES_SUPER2, SES_BUFINFO, SES_BLKLIST, SES_CHARS, SES_BLKTREE } BLKTYPE;
+
+/* A buffer's CHARS blocks are listed, in order, in BLKLIST blocks.  When a
+ * buffer needs more than one BLKLIST block, they're gathered into a B-tree
+ * whose interior nodes are BLKTREE blocks.  Each BLKTREE entry refers to a
+ * subtree and gives the number of CHARS blocks, characters, and newlines in
+ * it, so any logical block, offset, or line can be found by examining one
+ * block per level.  The bufinfo's "height" is the number of BLKTREE levels;
+ * if it is 0, then "first" refers to the buffer's only BLKLIST block.
  */
-typedef COUNT BLKNO;
-typedef COUNT LBLKNO;
-typedef _COUNT_ _BLKNO_;
-typedef _COUNT_ _LBLKNO_;
-typedef enum { SES_NEW, SES_SUPER, SES_SUPER2, SES_BUFINFO, SES_BLKLIST, SES_CHARS } BLKTYPE;
 
 typedef union
 {
 	struct
 	{
-		long	magic;		/* file type code: 0x0200DEAD */
+		long	magic;		/* file type code: 0x0302DEAD */
 		long	inuse;		/* in-use flag */
 		COUNT	blksize;	/* bytes per block */
 		BLKNO	next;		/* super2 block that continues buf[] */
@@ -64,15 +90,16 @@ typedef union
 	{
 		long	changes;	/* change counter */
 		long	prevloc;	/* where last change was made */
-		long	reserved;	/* nothing yet; always 0 */
-		BLKNO	first;		/* first text block list */
+		long	height;		/* number of BLKTREE levels in tree */
+		long	lazy;		/* text was left in the original file */
+		BLKNO	first;		/* root of the tree of block lists */
 		short	checksum;	/* checksum of this block */
 		CHAR	name[1];	/* buffer name */
 	} bufinfo;
 
 	struct
 	{
-		BLKNO	next;		/* ref to next block of BLKNO values */
+		BLKNO	next;		/* unused; always 0 */
 		struct blki_s
 		{
 			BLKNO	blkno;	/* which block stores next CHARs */
@@ -81,6 +108,18 @@ typedef union
 		}	blk[1];		/* list of blocks in this buffer */
 	} blklist;
 
+	struct
+	{
+		long	height;		/* height of this node; never 0 */
+		struct blkt_s
+		{
+			BLKNO	child;	/* a BLKLIST or lower BLKTREE block */
+			LBLKNO	nblks;	/* number of CHARS blocks in subtree */
+			long	nchars;	/* number of CHARs in subtree */
+			long	nlines;	/* number of '\n' CHARs in subtree */
+		}	kid[1];		/* list of subtrees, in order */
+	} blktree;
+
 	struct
 	{
 		CHAR	chars[1];	/* the bytes themselves */
@@ -95,6 +134,7 @@ typedef union
 #define SES_MAXSUPER2	((o_blksize - (size_t)(((BLK *)0)->super2.buf)) / sizeof(BLKNO))
 #define SES_MAXBUFINFO	((o_blksize - (size_t)(((BLK *)0)->bufinfo.name)) / sizeof(CHAR))
 #define SES_MAXBLKLIST	((o_blksize - (size_t)(((BLK *)0)->blklist.blk)) / sizeof(((BLK *)0)->blklist.blk[0]))
+#define SES_MAXBLKTREE	((o_blksize - (size_t)(((BLK *)0)->blktree.kid)) / sizeof(((BLK *)0)->blktree.kid[0]))
 #define SES_MAXCHARS	(o_blksize / sizeof(CHAR))
 
 
@@ -104,10 +144,18 @@ typedef union
 BEGIN_EXTERNC
 extern void	sesopen P_((ELVBOOL force));
 extern void	sesclose P_((void));
+extern int	sesrefs P_((_BLKNO_ blkno));
+extern void	sesnear P_((_BLKNO_ blkno));
+#ifdef FEATURE_LAZYLOAD
+extern BLKNO	seslazy P_((char *filename, long minsize, int *nblks, long *size));
+extern void	sesunlazy P_((char *filename));
+#endif
 extern BLK	*sesblk P_((_BLKNO_));
 extern void	sesunlock P_((_BLKNO_ blkno, ELVBOOL forwrite));
 extern void	sesflush P_((_BLKNO_ blkno));
 extern void	sessync P_((void));
+extern void	sesstats P_((ELVBOOL reset));
+extern void	sesahead P_((_BLKNO_ from, BLKNO *blks, int n));
 END_EXTERNC
 #ifdef DEBUG_SESSION
 # define seslock(b,f,t)	_seslock(__FILE__, __LINE__, b, f, t)